@@ -0,0 +1,209 @@
+#ifndef COMMON_ADT_BIT_SET_HPP
+#define COMMON_ADT_BIT_SET_HPP
+
+#include "common/adt/hash.hpp"
+#include "common/general.hpp"
+#include "common/mem.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ucl {
+
+// Fixed size set of bits. Words are padded to whole blocks of 256 bits, so the set operations below run one AVX2
+// or two SSE2 instructions per block without a scalar tail
+struct BitSet {
+  static const i32 block_words = 4;
+
+  struct Iterator {
+    i32 operator*() const { return word_index * 64 + __builtin_ctzll(word); }
+
+    Iterator &operator++() {
+      word &= word - 1;
+      while (!word && ++word_index < parent->word_count) word = parent->words[word_index];
+      return *this;
+    }
+
+    friend bool operator!=(const Iterator &iterator1, const Iterator &iterator2) {
+      return iterator1.word_index != iterator2.word_index;
+    }
+
+    u64 word; // Bits of the current word not visited yet
+    i32 word_index;
+    BitSet *parent;
+  };
+
+  void init(Allocator *allocator, i32 bits) {
+    INIT_MEMCHECK
+    bit_count  = bits;
+    word_count = (bits + block_words * 64 - 1) / (block_words * 64) * block_words;
+    words      = word_count ? allocator->construct<u64>(word_count) : nullptr;
+    clear();
+  }
+
+  Iterator begin() {
+    ASSERT_MEMCHECK
+    Iterator iterator{0, -1, this};
+    iterator.word = 1;
+    return ++iterator;
+  }
+
+  Iterator end() {
+    ASSERT_MEMCHECK
+    return {0, word_count, this};
+  }
+
+  void clear() {
+    ASSERT_MEMCHECK
+    memory_clear(words, word_count);
+  }
+
+  // Clears the words holding bits first to last, cheaper than clear() when the set bits are known to be close
+  void clear_range(i32 first, i32 last) {
+    ASSERT_MEMCHECK
+    assert(first <= last && last < bit_count);
+    memory_clear(&words[first / 64], last / 64 - first / 64 + 1);
+  }
+
+  bool test(i32 bit) {
+    ASSERT_MEMCHECK
+    assert(bit < bit_count);
+    return (words[bit / 64] >> u32(bit % 64)) & 1U;
+  }
+
+  void set(i32 bit) {
+    ASSERT_MEMCHECK
+    assert(bit < bit_count);
+    words[bit / 64] |= u64(1) << u32(bit % 64);
+  }
+
+  void reset(i32 bit) {
+    ASSERT_MEMCHECK
+    assert(bit < bit_count);
+    words[bit / 64] &= ~(u64(1) << u32(bit % 64));
+  }
+
+  void copy_from(BitSet *other) {
+    ASSERT_MEMCHECK
+    assert(word_count == other->word_count);
+    memory_copy(words, other->words, word_count);
+  }
+
+  // Returns true when a bit was added, which is the fixpoint test of a dataflow pass
+  bool union_with(BitSet *other) {
+    ASSERT_MEMCHECK
+    assert(word_count == other->word_count);
+#if defined(__AVX2__)
+    __m256i added = _mm256_setzero_si256();
+    for (i32 i = 0; i < word_count; i += block_words) {
+      __m256i current = _mm256_loadu_si256((const __m256i *)&words[i]);
+      __m256i merged  = _mm256_or_si256(current, _mm256_loadu_si256((const __m256i *)&other->words[i]));
+      added           = _mm256_or_si256(added, _mm256_xor_si256(merged, current));
+      _mm256_storeu_si256((__m256i *)&words[i], merged);
+    }
+    return !_mm256_testz_si256(added, added);
+#elif defined(__SSE2__)
+    __m128i added = _mm_setzero_si128();
+    for (i32 i = 0; i < word_count; i += 2) {
+      __m128i current = _mm_loadu_si128((const __m128i *)&words[i]);
+      __m128i merged  = _mm_or_si128(current, _mm_loadu_si128((const __m128i *)&other->words[i]));
+      added           = _mm_or_si128(added, _mm_xor_si128(merged, current));
+      _mm_storeu_si128((__m128i *)&words[i], merged);
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(added, _mm_setzero_si128())) != 0xFFFF;
+#else
+    u64 added = 0;
+    for (i32 i = 0; i < word_count; ++i) {
+      u64 merged = words[i] | other->words[i];
+      added |= merged ^ words[i];
+      words[i] = merged;
+    }
+    return added;
+#endif
+  }
+
+  void intersect_with(BitSet *other) {
+    ASSERT_MEMCHECK
+    assert(word_count == other->word_count);
+#if defined(__AVX2__)
+    for (i32 i = 0; i < word_count; i += block_words) {
+      __m256i current = _mm256_loadu_si256((const __m256i *)&words[i]);
+      __m256i masked  = _mm256_and_si256(current, _mm256_loadu_si256((const __m256i *)&other->words[i]));
+      _mm256_storeu_si256((__m256i *)&words[i], masked);
+    }
+#elif defined(__SSE2__)
+    for (i32 i = 0; i < word_count; i += 2) {
+      __m128i current = _mm_loadu_si128((const __m128i *)&words[i]);
+      __m128i masked  = _mm_and_si128(current, _mm_loadu_si128((const __m128i *)&other->words[i]));
+      _mm_storeu_si128((__m128i *)&words[i], masked);
+    }
+#else
+    for (i32 i = 0; i < word_count; ++i) words[i] &= other->words[i];
+#endif
+  }
+
+  // Removes every bit of other
+  void subtract(BitSet *other) {
+    ASSERT_MEMCHECK
+    assert(word_count == other->word_count);
+#if defined(__AVX2__)
+    for (i32 i = 0; i < word_count; i += block_words) {
+      __m256i current = _mm256_loadu_si256((const __m256i *)&words[i]);
+      __m256i masked  = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *)&other->words[i]), current);
+      _mm256_storeu_si256((__m256i *)&words[i], masked);
+    }
+#elif defined(__SSE2__)
+    for (i32 i = 0; i < word_count; i += 2) {
+      __m128i current = _mm_loadu_si128((const __m128i *)&words[i]);
+      __m128i masked  = _mm_andnot_si128(_mm_loadu_si128((const __m128i *)&other->words[i]), current);
+      _mm_storeu_si128((__m128i *)&words[i], masked);
+    }
+#else
+    for (i32 i = 0; i < word_count; ++i) words[i] &= ~other->words[i];
+#endif
+  }
+
+  bool is_empty() {
+    ASSERT_MEMCHECK
+    u64 any = 0;
+    for (i32 i = 0; i < word_count; ++i) any |= words[i];
+    return !any;
+  }
+
+  // Neither AVX2 nor SSE2 has a population count, so words are counted one at a time
+  i32 count() {
+    ASSERT_MEMCHECK
+    i32 bits = 0;
+    for (i32 i = 0; i < word_count; ++i) bits += __builtin_popcountll(words[i]);
+    return bits;
+  }
+
+  u64 *words;
+  i32 word_count; // Multiple of block_words
+  i32 bit_count;
+  DEFINE_MEMCHECK
+};
+
+template <>
+struct HashFn<BitSet> {
+  static constexpr bool cache_hash = true;
+
+  // An empty set has no words to point at
+  HashValue operator()(BitSet set) {
+    if (!set.word_count) return HashValue(0);
+    return fold_hash(hash_memory(set.words, usize(set.word_count) * sizeof(u64)));
+  }
+};
+
+template <>
+struct EqualFn<BitSet> {
+  bool operator()(BitSet set1, BitSet set2) {
+    if (set1.word_count != set2.word_count) return false;
+    return !set1.word_count || !memcmp(set1.words, set2.words, usize(set1.word_count) * sizeof(u64));
+  }
+};
+
+} // namespace ucl
+
+#endif
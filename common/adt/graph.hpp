@@ -1,6 +1,7 @@
 #ifndef COMMON_ADT_GRAPH_HPP
 #define COMMON_ADT_GRAPH_HPP
 
+#include "common/adt/graph_algorithms.hpp"
 #include "common/adt/set.hpp"
 #include "common/adt/vec.hpp"
 #include "common/general.hpp"
@@ -8,10 +9,12 @@
 
 namespace ucl {
 
-template <typename T, typename E>
+// EdgeList is the container of a node's outgoing edges, Vec or SmallVec
+template <typename T, typename E, typename EdgeList = Vec<E>>
 struct Node {
   T data;
-  Vec<E> edges;
+  EdgeList edges;
+  u32 index; // Position in the nodes of its graph, set by add_node
 };
 
 template <typename T>
@@ -19,9 +22,74 @@ struct Edge {
   Node<T, Edge<T>> *dest;
 };
 
-template <typename T, typename E = Edge<T>>
+// Read only graph in compressed sparse row form. Node data, edges and the destination id of every edge each lie in
+// one contiguous array, the edges of node id are edges[edge_offsets[id]] up to edges[edge_offsets[id + 1]]
+template <typename T, typename E>
+struct FrozenGraph {
+  struct Iterator {
+    T *operator*() const { return current; }
+
+    Iterator &operator++() {
+      ++current;
+      return *this;
+    }
+
+    friend bool operator!=(const Iterator &iterator1, const Iterator &iterator2) {
+      return iterator1.current != iterator2.current;
+    }
+
+    T *current;
+  };
+
+  struct EdgeIterator {
+    E *operator*() const { return current; }
+
+    EdgeIterator &operator++() {
+      ++current;
+      return *this;
+    }
+
+    friend bool operator!=(const EdgeIterator &iterator1, const EdgeIterator &iterator2) {
+      return iterator1.current != iterator2.current;
+    }
+
+    E *current;
+  };
+
+  struct EdgeRange {
+    EdgeIterator begin() { return {first}; }
+
+    EdgeIterator end() { return {last}; }
+
+    E *first;
+    E *last;
+  };
+
+  Iterator begin() { return {nodes}; }
+
+  Iterator end() { return {nodes + node_count}; }
+
+  u32 id_of(T *node) { return u32(node - nodes); }
+
+  EdgeRange edges_of(u32 id) { return {&edges[edge_offsets[id]], &edges[edge_offsets[id + 1]]}; }
+
+  u32 destination(E *edge) { return edge_destinations[edge - edges]; }
+
+  GraphView view() { return {node_count, edge_offsets, edge_destinations}; }
+
+  NodeOrder post_order(Allocator *allocator) { return depth_first_post_order(allocator, view(), nullptr, 0); }
+
+  T *nodes;
+  u32 *edge_offsets; // node_count + 1 entries
+  E *edges;
+  u32 *edge_destinations;
+  u32 node_count;
+  u32 edge_count;
+};
+
+template <typename T, typename E = Edge<T>, typename EdgeList = Vec<E>>
 struct Graph {
-  using NodeType = Node<T, E>;
+  using NodeType = Node<T, E, EdgeList>;
   using NodeList = Vec<NodeType *>;
 
   using EdgeType = E;
@@ -78,33 +146,61 @@ struct Graph {
     Iterator end() { return {ordering + graph->nodes.length}; }
 
     NodeType **ordering;
-    Graph<T, E> *graph;
+    Graph<T, E, EdgeList> *graph;
   };
 
-  void impl_post_order(Allocator *allocator, NodeType ***ordering, NodeType *current, Set<NodeType *> *visited) {
-    visited->insert(allocator, current);
-
-    for (auto *edge : current->edges) {
-      if (!visited->has(edge->dest)) impl_post_order(allocator, ordering, edge->dest, visited);
-    }
-
-    **ordering = current;
-    ++(*ordering);
-  }
-
   OrderedIterator post_order(Allocator *allocator) {
     ASSERT_MEMCHECK
     OrderedIterator post_ordering;
     post_ordering.ordering = allocator->construct<NodeType *>(nodes.length);
     post_ordering.graph    = this;
 
-    Set<NodeType *> visited;
-    visited.init();
-    auto *ordering = post_ordering.ordering;
+    BumpScope traversal_scope(allocator);
+    auto ids = depth_first_post_order(allocator, adjacency(allocator), nullptr, 0);
+    for (u32 i = 0; i < ids.count; ++i) post_ordering.ordering[i] = nodes.get(i32(ids.ids[i]));
+    return post_ordering;
+  }
+
+  // Successor ids of every node, ids are the node indices
+  GraphView adjacency(Allocator *allocator) {
+    ASSERT_MEMCHECK
+    u32 edge_count = 0;
+    for (auto *node : *this) edge_count += u32(node->edges.length);
+
+    GraphView graph_view;
+    graph_view.node_count        = u32(nodes.length);
+    graph_view.edge_offsets      = allocator->construct<u32>(graph_view.node_count + 1);
+    graph_view.edge_destinations = allocator->construct<u32>(edge_count);
+
+    u32 edge_offset = 0;
     for (i32 i = 0; i < nodes.length; ++i) {
-      if (!visited.has(nodes.get(i))) impl_post_order(allocator, &ordering, nodes.get(i), &visited);
+      graph_view.edge_offsets[i] = edge_offset;
+      for (auto *edge : nodes.get(i)->edges) graph_view.edge_destinations[edge_offset++] = edge->dest->index;
     }
-    return post_ordering;
+    graph_view.edge_offsets[graph_view.node_count] = edge_offset;
+    return graph_view;
+  }
+
+  // Packs the graph into allocator, node ids are indices into nodes. Edges keep their dest pointers into this graph
+  FrozenGraph<T, E> freeze(Allocator *allocator) {
+    ASSERT_MEMCHECK
+    auto graph_view = adjacency(allocator);
+
+    FrozenGraph<T, E> frozen;
+    frozen.node_count        = graph_view.node_count;
+    frozen.edge_count        = graph_view.edge_offsets[graph_view.node_count];
+    frozen.edge_offsets      = graph_view.edge_offsets;
+    frozen.edge_destinations = graph_view.edge_destinations;
+    frozen.nodes             = allocator->construct<T>(frozen.node_count);
+    frozen.edges             = allocator->construct<E>(frozen.edge_count);
+
+    u32 edge_offset = 0;
+    for (i32 i = 0; i < nodes.length; ++i) {
+      auto *node      = nodes.get(i);
+      frozen.nodes[i] = node->data;
+      for (auto *edge : node->edges) frozen.edges[edge_offset++] = *edge;
+    }
+    return frozen;
   }
 
   NodeType *add_node(Allocator *allocator, T &node_data) {
@@ -115,7 +211,8 @@ struct Graph {
     auto *node   = allocator->construct<NodeType>();
     nodes.back() = node;
 
-    node->data = node_data;
+    node->data  = node_data;
+    node->index = u32(nodes.length - 1);
     node->edges.init();
     return node;
   }
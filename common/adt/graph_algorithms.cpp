@@ -0,0 +1,183 @@
+#include "common/adt/graph_algorithms.hpp"
+
+#include "common/adt/bit_set.hpp"
+
+namespace ucl {
+
+NodeOrder depth_first_post_order(Allocator *allocator, GraphView graph, u32 *roots, u32 root_count) {
+  NodeOrder post_order{allocator->construct<u32>(graph.node_count), 0};
+
+  BumpScope traversal_scope(allocator);
+  auto *stack      = allocator->construct<u32>(graph.node_count);
+  auto *next_edges = allocator->construct<u32>(graph.node_count); // Next edge to follow for each node on the stack
+  u32 stack_length = 0;
+  BitSet visited;
+  visited.init(allocator, i32(graph.node_count));
+
+  u32 start_count = roots ? root_count : graph.node_count;
+  for (u32 i = 0; i < start_count; ++i) {
+    u32 root = roots ? roots[i] : i;
+    if (visited.test(i32(root))) continue;
+    visited.set(i32(root));
+    stack[stack_length++] = root;
+    next_edges[root]      = graph.edge_offsets[root];
+    while (stack_length) {
+      u32 current = stack[stack_length - 1];
+      if (next_edges[current] == graph.edge_offsets[current + 1]) {
+        post_order.ids[post_order.count++] = current;
+        --stack_length;
+        continue;
+      }
+      u32 destination = graph.edge_destinations[next_edges[current]++];
+      if (visited.test(i32(destination))) continue;
+      visited.set(i32(destination));
+      stack[stack_length++]   = destination;
+      next_edges[destination] = graph.edge_offsets[destination];
+    }
+  }
+  return post_order;
+}
+
+NodeOrder reverse_post_order(Allocator *allocator, GraphView graph, u32 entry) {
+  auto order = depth_first_post_order(allocator, graph, &entry, 1);
+  for (u32 i = 0; i < order.count / 2; ++i) {
+    u32 swapped                    = order.ids[i];
+    order.ids[i]                   = order.ids[order.count - 1 - i];
+    order.ids[order.count - 1 - i] = swapped;
+  }
+  return order;
+}
+
+GraphView reverse_graph(Allocator *allocator, GraphView graph) {
+  u32 edge_count = graph.edge_offsets[graph.node_count];
+
+  GraphView reversed;
+  reversed.node_count        = graph.node_count;
+  reversed.edge_offsets      = allocator->construct<u32>(graph.node_count + 1);
+  reversed.edge_destinations = allocator->construct<u32>(edge_count);
+  memory_clear(reversed.edge_offsets, i32(graph.node_count + 1));
+
+  // Counting sort by destination, edge_offsets[id + 1] first counts the predecessors of id
+  for (u32 i = 0; i < edge_count; ++i) ++reversed.edge_offsets[graph.edge_destinations[i] + 1];
+  for (u32 id = 0; id < graph.node_count; ++id) reversed.edge_offsets[id + 1] += reversed.edge_offsets[id];
+
+  BumpScope fill_scope(allocator);
+  auto *fill_offsets = allocator->construct<u32>(graph.node_count);
+  memory_copy(fill_offsets, reversed.edge_offsets, i32(graph.node_count));
+  for (u32 source = 0; source < graph.node_count; ++source) {
+    for (u32 i = graph.edge_offsets[source]; i < graph.edge_offsets[source + 1]; ++i) {
+      reversed.edge_destinations[fill_offsets[graph.edge_destinations[i]]++] = source;
+    }
+  }
+  return reversed;
+}
+
+StronglyConnectedComponents strongly_connected_components(Allocator *allocator, GraphView graph) {
+  const u32 unvisited = u32(-1);
+
+  StronglyConnectedComponents components{allocator->construct<u32>(graph.node_count), 0};
+
+  BumpScope traversal_scope(allocator);
+  auto *visit_index     = allocator->construct<u32>(graph.node_count);
+  auto *low_link        = allocator->construct<u32>(graph.node_count);
+  auto *next_edges      = allocator->construct<u32>(graph.node_count);
+  auto *call_stack      = allocator->construct<u32>(graph.node_count);
+  auto *component_stack = allocator->construct<u32>(graph.node_count);
+  u32 call_stack_length = 0;
+  u32 component_length  = 0;
+  u32 visit_count       = 0;
+  for (u32 id = 0; id < graph.node_count; ++id) visit_index[id] = unvisited;
+  BitSet on_stack;
+  on_stack.init(allocator, i32(graph.node_count));
+
+  for (u32 root = 0; root < graph.node_count; ++root) {
+    if (visit_index[root] != unvisited) continue;
+
+    u32 entered = root;
+    for (;;) {
+      if (entered != unvisited) {
+        visit_index[entered]                = visit_count;
+        low_link[entered]                   = visit_count++;
+        next_edges[entered]                 = graph.edge_offsets[entered];
+        call_stack[call_stack_length++]     = entered;
+        component_stack[component_length++] = entered;
+        on_stack.set(i32(entered));
+        entered = unvisited;
+      }
+      if (!call_stack_length) break;
+
+      u32 current = call_stack[call_stack_length - 1];
+      if (next_edges[current] < graph.edge_offsets[current + 1]) {
+        u32 destination = graph.edge_destinations[next_edges[current]++];
+        if (visit_index[destination] == unvisited) {
+          entered = destination;
+        } else if (on_stack.test(i32(destination)) && visit_index[destination] < low_link[current]) {
+          low_link[current] = visit_index[destination];
+        }
+        continue;
+      }
+
+      // Every successor is done, a node which reaches nothing older than itself roots a component
+      --call_stack_length;
+      if (low_link[current] == visit_index[current]) {
+        u32 member;
+        do {
+          member = component_stack[--component_length];
+          on_stack.reset(i32(member));
+          components.component_of[member] = components.component_count;
+        } while (member != current);
+        ++components.component_count;
+      }
+      if (call_stack_length) {
+        u32 parent = call_stack[call_stack_length - 1];
+        if (low_link[current] < low_link[parent]) low_link[parent] = low_link[current];
+      }
+    }
+  }
+  return components;
+}
+
+u32 *immediate_dominators(Allocator *allocator, GraphView graph, u32 entry) {
+  auto *dominators = allocator->construct<u32>(graph.node_count);
+  for (u32 id = 0; id < graph.node_count; ++id) dominators[id] = no_node;
+
+  BumpScope dominator_scope(allocator);
+  auto order        = reverse_post_order(allocator, graph, entry);
+  auto predecessors = reverse_graph(allocator, graph);
+  auto *order_index = allocator->construct<u32>(graph.node_count); // Position of each reachable node in order
+  for (u32 i = 0; i < order.count; ++i) order_index[order.ids[i]] = i;
+
+  dominators[entry] = entry;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (u32 i = 1; i < order.count; ++i) {
+      u32 node = order.ids[i];
+
+      // Intersects the dominators of every processed predecessor by walking both up the tree until they meet
+      u32 new_dominator = no_node;
+      for (u32 k = predecessors.edge_offsets[node]; k < predecessors.edge_offsets[node + 1]; ++k) {
+        u32 predecessor = predecessors.edge_destinations[k];
+        if (dominators[predecessor] == no_node) continue;
+        if (new_dominator == no_node) {
+          new_dominator = predecessor;
+          continue;
+        }
+        u32 finger1 = predecessor;
+        u32 finger2 = new_dominator;
+        while (finger1 != finger2) {
+          while (order_index[finger1] > order_index[finger2]) finger1 = dominators[finger1];
+          while (order_index[finger2] > order_index[finger1]) finger2 = dominators[finger2];
+        }
+        new_dominator = finger1;
+      }
+
+      if (dominators[node] != new_dominator) {
+        dominators[node] = new_dominator;
+        changed          = true;
+      }
+    }
+  }
+  return dominators;
+}
+
+} // namespace ucl
@@ -0,0 +1,69 @@
+#ifndef COMMON_ADT_GRAPH_ALGORITHMS_HPP
+#define COMMON_ADT_GRAPH_ALGORITHMS_HPP
+
+#include "common/general.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Adjacency in compressed sparse row form, the successors of node id are
+// edge_destinations[edge_offsets[id]] up to edge_destinations[edge_offsets[id + 1]]
+struct GraphView {
+  u32 node_count;
+  u32 *edge_offsets; // node_count + 1 entries
+  u32 *edge_destinations;
+};
+
+struct NodeOrder {
+  struct Iterator {
+    u32 operator*() const { return *current; }
+
+    Iterator &operator++() {
+      ++current;
+      return *this;
+    }
+
+    friend bool operator!=(const Iterator &iterator1, const Iterator &iterator2) {
+      return iterator1.current != iterator2.current;
+    }
+
+    u32 *current;
+  };
+
+  Iterator begin() { return {ids}; }
+
+  Iterator end() { return {ids + count}; }
+
+  u32 *ids;
+  u32 count;
+};
+
+struct StronglyConnectedComponents {
+  u32 *component_of; // Components are numbered in reverse topological order, edges never lead to a higher number
+  u32 component_count;
+};
+
+// Marks unreachable nodes in the results below
+const u32 no_node = u32(-1);
+
+// All traversals run on an explicit stack with a visited BitSet, so they take linear time and bounded native stack.
+// Results are allocated in allocator, temporaries are rolled back before returning
+
+// Depth first post order of the nodes reachable from roots, or of every node when roots is null
+NodeOrder depth_first_post_order(Allocator *allocator, GraphView graph, u32 *roots, u32 root_count);
+
+NodeOrder reverse_post_order(Allocator *allocator, GraphView graph, u32 entry);
+
+// Same nodes with every edge reversed, successors become predecessors
+GraphView reverse_graph(Allocator *allocator, GraphView graph);
+
+// Tarjan's algorithm
+StronglyConnectedComponents strongly_connected_components(Allocator *allocator, GraphView graph);
+
+// Immediate dominator of every node, by the iterative algorithm of Cooper, Harvey and Kennedy. The entry is its own
+// immediate dominator, nodes unreachable from entry get no_node
+u32 *immediate_dominators(Allocator *allocator, GraphView graph, u32 entry);
+
+} // namespace ucl
+
+#endif
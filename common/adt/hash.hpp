@@ -1,13 +1,72 @@
 #ifndef COMMON_ADT_HASH_HPP
 #define COMMON_ADT_HASH_HPP
 
+#include "common/adt/string.hpp"
 #include "common/general.hpp"
 #include <cstring>
+#include <type_traits>
 
 namespace ucl {
 
 using HashValue = i32;
 
+// Multiplies to 128 bits and folds the halves, every input bit reaches every output bit
+inline u64 hash_multiply_fold(u64 value1, u64 value2) {
+  __uint128_t product = __uint128_t(value1) * value2;
+  return u64(product) ^ u64(product >> 64U);
+}
+
+inline u64 hash_mix(u64 value) { return hash_multiply_fold(value ^ 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL); }
+
+inline u64 hash_read_word(const u8 *bytes) {
+  u64 word;
+  memcpy(&word, bytes, sizeof(u64));
+  return word;
+}
+
+inline u64 hash_read_half_word(const u8 *bytes) {
+  u32 half_word;
+  memcpy(&half_word, bytes, sizeof(u32));
+  return half_word;
+}
+
+// Hashes 16 bytes per step, the tail is read as two possibly overlapping words so no byte loop is needed. This stays
+// scalar on purpose: one 64x64->128 bit multiply folds 16 bytes, which SSE2 and AVX2 cannot match without a 64 bit
+// multiply, and the keys are short and hashed once when their table caches the hash
+inline u64 hash_memory(const void *bytes, usize length, u64 seed = 0) {
+  const u64 secret1 = 0xa0761d6478bd642fULL;
+  const u64 secret2 = 0xe7037ed1a0b428dbULL;
+
+  auto *current    = (const u8 *)bytes;
+  usize remaining  = length;
+  u64 hash         = seed ^ secret1;
+  for (; remaining > 16; remaining -= 16, current += 16) {
+    hash = hash_multiply_fold(hash_read_word(current) ^ secret2, hash_read_word(current + 8) ^ hash);
+  }
+
+  u64 word1 = 0;
+  u64 word2 = 0;
+  if (remaining >= 8) {
+    word1 = hash_read_word(current);
+    word2 = hash_read_word(current + remaining - 8);
+  } else if (remaining >= 4) {
+    word1 = hash_read_half_word(current) << 32U | hash_read_half_word(current + remaining - 4);
+  } else if (remaining > 0) {
+    word1 = u64(current[0]) << 16U | u64(current[remaining >> 1U]) << 8U | current[remaining - 1];
+  }
+  return hash_multiply_fold(secret2 ^ length, hash_multiply_fold(word1 ^ secret2, word2 ^ hash));
+}
+
+inline HashValue fold_hash(u64 hash) { return HashValue(u32(hash ^ (hash >> 32U))); }
+
+// Hash functions may set cache_hash when they are expensive, hash tables then keep the hash next to each entry so
+// neither rehashing nor a probe past a different key calls the hash or equal function again
+template <typename H, typename = void>
+struct CachesHash : std::false_type {};
+
+template <typename H>
+struct CachesHash<H, std::void_t<decltype(H::cache_hash)>> : std::integral_constant<bool, H::cache_hash> {};
+
 template <typename K>
 struct HashFn {
   static_assert(!sizeof(K /*unused*/), "No hash function implemented for type");
@@ -16,24 +75,31 @@ struct HashFn {
 
 template <typename K>
 struct HashFn<K *> {
-  HashValue operator()(K *ptr) { return uintptr_t(ptr) / sizeof(K); }
+  HashValue operator()(K *ptr) { return fold_hash(hash_mix(u64(uintptr_t(ptr)))); }
 };
 
 template <>
 struct HashFn<i32> {
-  HashValue operator()(i32 num) { return num; }
+  HashValue operator()(i32 num) { return fold_hash(hash_mix(u64(u32(num)))); }
+};
+
+template <>
+struct HashFn<u32> {
+  HashValue operator()(u32 num) { return fold_hash(hash_mix(u64(num))); }
 };
 
 template <>
 struct HashFn<cstr> {
-  HashValue operator()(cstr ptr) {
-    HashValue hash = 1;
-    while (*ptr) {
-      hash = ((hash << 5U) - hash) + HashValue(*ptr);
-      ++ptr;
-    }
-    return hash;
-  }
+  static constexpr bool cache_hash = true;
+
+  HashValue operator()(cstr ptr) { return fold_hash(hash_memory(ptr, strlen(ptr))); }
+};
+
+template <>
+struct HashFn<StringRef> {
+  static constexpr bool cache_hash = true;
+
+  HashValue operator()(StringRef string) { return fold_hash(hash_memory(string.str, usize(string.len))); }
 };
 
 template <typename K>
@@ -52,9 +118,21 @@ struct EqualFn<i32> {
   bool operator()(i32 num1, i32 num2) { return num1 == num2; }
 };
 
+template <>
+struct EqualFn<u32> {
+  bool operator()(u32 num1, u32 num2) { return num1 == num2; }
+};
+
 template <>
 struct EqualFn<cstr> {
-  bool operator()(cstr ptr1, cstr ptr2) { return strcmp(ptr1, ptr2); }
+  bool operator()(cstr ptr1, cstr ptr2) { return !strcmp(ptr1, ptr2); }
+};
+
+template <>
+struct EqualFn<StringRef> {
+  bool operator()(StringRef string1, StringRef string2) {
+    return string1.len == string2.len && !memcmp(string1.str, string2.str, usize(string1.len));
+  }
 };
 
 } // namespace ucl
@@ -3,6 +3,7 @@
 
 #include "common/adt/hash.hpp"
 #include "common/adt/set.hpp"
+#include "common/adt/swiss_set.hpp"
 #include "common/general.hpp"
 #include "common/mem.hpp"
 
@@ -16,6 +17,8 @@ struct Entry {
 
 template <typename K, typename V>
 struct HashFn<Entry<K, V>> {
+  static constexpr bool cache_hash = CachesHash<HashFn<K>>::value;
+
   HashValue operator()(Entry<K, V> entry) { return HashFn<K>()(entry.key); }
 };
 
@@ -24,14 +27,15 @@ struct EqualFn<Entry<K, V>> {
   bool operator()(Entry<K, V> entry1, Entry<K, V> entry2) { return EqualFn<K>()(entry1.key, entry2.key); }
 };
 
-template <typename K, typename V>
+// Table selects the set backend, impl::Set or impl::SwissSet
+template <typename K, typename V, template <typename, typename, typename> class Table = impl::Set>
 struct Map {
   using Key   = K;
   using Value = V;
 
   using EntryT = Entry<K, V>;
 
-  using SetT = Set<EntryT>;
+  using SetT = Table<EntryT, HashFn<EntryT>, EqualFn<EntryT>>;
 
   void init() {
     INIT_MEMCHECK
@@ -76,10 +80,23 @@ struct Map {
 
   Value *get(Key &&key) { return get(key); }
 
+  bool erase(Key &key) {
+    EntryT entry;
+    entry.key = key;
+    return set.erase(entry);
+  }
+
+  bool erase(Key &&key) { return erase(key); }
+
+  void shrink_to_fit(Allocator *allocator) { set.shrink_to_fit(allocator); }
+
   SetT set;
   DEFINE_MEMCHECK
 };
 
+template <typename K, typename V>
+using SwissMap = Map<K, V, impl::SwissSet>;
+
 } // namespace ucl
 
 #endif
@@ -9,6 +9,15 @@ namespace ucl {
 
 namespace impl {
 
+// Hash of a table entry, only stored when the hash function is expensive enough to be worth the space
+template <bool cached>
+struct SlotHash {};
+
+template <>
+struct SlotHash<true> {
+  HashValue hash;
+};
+
 // Robin hood algorithm based hashtable
 template <typename T, typename H, typename E>
 struct Set {
@@ -17,7 +26,9 @@ struct Set {
 
   using SetT = Set<T, H, E>;
 
-  struct TableSlot {
+  static constexpr bool cache_hash = CachesHash<Hash>::value;
+
+  struct TableSlot : SlotHash<cache_hash> {
     T data;
     i32 distance; // Distance from preferred hash slot, distance=0 means entry is empty
   };
@@ -78,65 +89,147 @@ struct Set {
     return {capacity, this};
   }
 
+  static HashValue slot_hash(TableSlot &slot) {
+    if constexpr (cache_hash) {
+      return slot.hash;
+    } else {
+      return Hash()(slot.data);
+    }
+  }
+
+  // Cached hashes rule out most unequal entries without calling the equal function
+  static bool slot_matches(TableSlot &slot, T &data, HashValue hash) {
+    if constexpr (cache_hash) {
+      if (slot.hash != hash) return false;
+    }
+    return Equal()(slot.data, data);
+  }
+
   T *insert(Allocator *allocator, T &data) {
     ASSERT_MEMCHECK
     // Load factor of 0.5
-    if (length + 1 > capacity >> 1) {
-      auto *old_table  = table;
-      i32 old_capacity = capacity;
-
-      capacity = capacity ? capacity << 1 : 8;
-
-      table = allocator->construct<TableSlot>(capacity);
-
-      clear();
-
-      for (i32 i = 0; i < old_capacity; ++i) {
-        if (old_table[i].distance) insert(allocator, old_table[i].data);
-      }
-    }
+    if (length + 1 > capacity >> 1) grow(allocator);
+    return insert_hashed(data, Hash()(data));
+  }
 
-    TableSlot temp_slot;
-    auto *data_pointer = &data;
-    i32 index          = Hash()(data) & (capacity - 1);
-    i32 distance       = 1;
+  T *insert_hashed(T &data, HashValue hash) {
+    ASSERT_MEMCHECK
+    TableSlot carried_slot;
+    carried_slot.data     = data;
+    carried_slot.distance = 1;
+    if constexpr (cache_hash) carried_slot.hash = hash;
+    i32 index = hash & (capacity - 1);
     for (i32 off = 0; off < capacity; ++off) {
       if (table[index].distance == 0) {
-        if (distance > max_distance) max_distance = distance;
+        if (carried_slot.distance > max_distance) max_distance = carried_slot.distance;
 
-        table[index].data     = *data_pointer;
-        table[index].distance = distance;
+        table[index] = carried_slot;
         ++length;
         return nullptr;
       }
 
-      if (Equal()(table[index].data, *data_pointer)) return &table[index].data;
-
-      if (table[index].distance < distance) {
-        if (distance > max_distance) max_distance = distance;
-
-        temp_slot = table[index];
+      if (slot_matches(table[index], data, hash)) return &table[index].data;
 
-        table[index].data     = *data_pointer;
-        table[index].distance = distance;
+      if (table[index].distance < carried_slot.distance) {
+        if (carried_slot.distance > max_distance) max_distance = carried_slot.distance;
 
-        data_pointer = &temp_slot.data;
-        distance     = temp_slot.distance;
+        TableSlot displaced_slot = table[index];
+        table[index]             = carried_slot;
+        carried_slot             = displaced_slot;
       }
       index = (index + 1) & (capacity - 1);
-      ++distance;
+      ++carried_slot.distance;
     }
     panic("Hash table is unexpectedly full");
   }
 
-  T *get(T &data) {
+  void grow(Allocator *allocator) {
     ASSERT_MEMCHECK
-    i32 index = Hash()(data) & (capacity - 1);
+    auto *old_table  = table;
+    i32 old_capacity = capacity;
+
+    capacity = capacity ? capacity << 1 : 8;
+
+    // A table which is the last allocation grows in place. Its entries move past the new table while they are
+    // reinserted, then that space is given back
+    if (allocator->try_extend(table, old_capacity, capacity + old_capacity)) {
+      old_table = table + capacity;
+      memory_copy(old_table, table, old_capacity);
+      clear();
+      for (i32 i = 0; i < old_capacity; ++i) {
+        if (old_table[i].distance) insert_hashed(old_table[i].data, slot_hash(old_table[i]));
+      }
+      allocator->try_extend(table, capacity + old_capacity, capacity);
+      return;
+    }
+
+    rehash(allocator, old_table, old_capacity);
+  }
+
+  // Moves the entries of old_table into a new table of the current capacity
+  void rehash(Allocator *allocator, TableSlot *old_table, i32 old_capacity) {
+    table = allocator->construct<TableSlot>(capacity);
+    clear();
+    for (i32 i = 0; i < old_capacity; ++i) {
+      if (old_table[i].distance) insert_hashed(old_table[i].data, slot_hash(old_table[i]));
+    }
+    if (old_table) allocator->discard(old_table, old_capacity);
+  }
+
+  // Rehashes into the smallest table which holds the entries at the load factor
+  void shrink_to_fit(Allocator *allocator) {
+    ASSERT_MEMCHECK
+    i32 new_capacity = 8;
+    while (length > new_capacity >> 1) new_capacity <<= 1;
+    if (new_capacity >= capacity) return;
+
+    auto *old_table  = table;
+    i32 old_capacity = capacity;
+    capacity         = new_capacity;
+    rehash(allocator, old_table, old_capacity);
+  }
+
+  // Backward shift deletion, the entries following the erased one move a slot closer to their preferred slot so no
+  // tombstones are left behind
+  bool erase(T &data) {
+    ASSERT_MEMCHECK
+    i32 index = find_index(data);
+    if (index < 0) return false;
+
+    i32 next_index = (index + 1) & (capacity - 1);
+    while (table[next_index].distance > 1) {
+      table[index] = table[next_index];
+      --table[index].distance;
+      index      = next_index;
+      next_index = (next_index + 1) & (capacity - 1);
+    }
+    table[index].distance = 0;
+
+    // Distances only shrink, so max_distance stays a bound until the table empties
+    if (--length == 0) max_distance = 0;
+    return true;
+  }
+
+  bool erase(T &&data) { return erase(data); }
+
+  // Entries are ordered by distance along a probe sequence, so the search ends at the first entry closer to its
+  // preferred slot than data would be
+  i32 find_index(T &data) {
+    ASSERT_MEMCHECK
+    if (!capacity) return -1;
+    HashValue hash = Hash()(data);
+    i32 index      = hash & (capacity - 1);
     for (i32 off = 0; off < max_distance; ++off) {
-      if (table[index].distance && Equal()(table[index].data, data)) return &table[index].data;
+      if (table[index].distance <= off) return -1;
+      if (slot_matches(table[index], data, hash)) return index;
       index = (index + 1) & (capacity - 1);
     }
-    return nullptr;
+    return -1;
+  }
+
+  T *get(T &data) {
+    i32 index = find_index(data);
+    return index < 0 ? nullptr : &table[index].data;
   }
 
   T *get(T &&data) { return get(data); }
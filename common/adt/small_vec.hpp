@@ -0,0 +1,128 @@
+#ifndef COMMON_ADT_SMALL_VEC_HPP
+#define COMMON_ADT_SMALL_VEC_HPP
+
+#include "common/general.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Vec holding its first N elements inline, only larger vectors allocate. data points into the vector itself until it
+// spills, so a SmallVec must not be copied or moved after init()
+template <typename T, i32 N>
+struct SmallVec {
+  static_assert(N > 0, "SmallVec needs inline capacity, use Vec instead");
+
+  struct Iterator {
+    T *operator*() const { return current; }
+
+    T *operator->() const { return current; }
+
+    Iterator &operator++() {
+      ++current;
+      return *this;
+    }
+
+    friend bool operator!=(const Iterator &iterator1, const Iterator &iterator2) {
+      return iterator1.current != iterator2.current;
+    }
+
+    T *current;
+  };
+
+  void init() {
+    INIT_MEMCHECK
+    data     = inline_data;
+    length   = 0;
+    capacity = N;
+  }
+
+  bool is_inline() { return data == inline_data; }
+
+  Iterator begin() {
+    ASSERT_MEMCHECK
+    return {data};
+  }
+
+  Iterator end() {
+    ASSERT_MEMCHECK
+    return {&data[length]};
+  }
+
+  void reserve(Allocator *allocator, i32 new_capacity) {
+    ASSERT_MEMCHECK
+    assert(new_capacity >= 0);
+    if (capacity < new_capacity) {
+      i32 grown_capacity = capacity;
+      while (grown_capacity < new_capacity) {
+        // cap = cap * 1.5 + 8
+        grown_capacity = (grown_capacity << 1) - (grown_capacity >> 1) + 8;
+      }
+      resize(allocator, grown_capacity);
+    }
+  }
+
+  // Never shrinks back into the inline storage
+  void resize(Allocator *allocator, i32 new_capacity) {
+    ASSERT_MEMCHECK
+    if (new_capacity <= capacity) return;
+    if (!is_inline() && allocator->try_extend(data, capacity, new_capacity)) {
+      capacity = new_capacity;
+      return;
+    }
+
+    T *new_data = allocator->construct<T>(new_capacity);
+    memory_copy(new_data, data, length);
+    if (!is_inline()) allocator->discard(data, capacity);
+    data     = new_data;
+    capacity = new_capacity;
+  }
+
+  void clear() { length = 0; }
+
+  T &front() {
+    ASSERT_MEMCHECK
+    assert(length > 0);
+    return data[0];
+  }
+
+  T &back() {
+    ASSERT_MEMCHECK
+    assert(length > 0);
+    return data[length - 1];
+  }
+
+  void push_back(Allocator *allocator, T &value) {
+    ASSERT_MEMCHECK
+    reserve(allocator, length + 1);
+    data[length++] = value;
+  }
+
+  void push_back(Allocator *allocator, T &&value) { push_back(allocator, value); }
+
+  void pop_back() {
+    ASSERT_MEMCHECK
+    --length;
+  }
+
+  T get(i32 index) {
+    ASSERT_MEMCHECK
+    assert(index < length);
+    return data[index];
+  }
+
+  T *get_reference(i32 index) {
+    ASSERT_MEMCHECK
+    assert(index < length);
+    return &data[index];
+  }
+
+  T *data; // inline_data until the vector outgrows it
+  i32 length;
+  i32 capacity;
+  T inline_data[usize(N)];
+  DEFINE_MEMCHECK
+};
+
+} // namespace ucl
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef COMMON_ADT_STRING_INTERNER_HPP
+#define COMMON_ADT_STRING_INTERNER_HPP
+
+#include "common/adt/hash.hpp"
+#include "common/adt/set.hpp"
+#include "common/adt/string.hpp"
+#include "common/adt/vec.hpp"
+#include "common/general.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+struct InternedString {
+  StringRef string;
+  u32 id;
+};
+
+template <>
+struct HashFn<InternedString> {
+  static constexpr bool cache_hash = true;
+
+  HashValue operator()(InternedString interned) { return HashFn<StringRef>()(interned.string); }
+};
+
+template <>
+struct EqualFn<InternedString> {
+  bool operator()(InternedString interned1, InternedString interned2) {
+    return EqualFn<StringRef>()(interned1.string, interned2.string);
+  }
+};
+
+// Maps each distinct string to a dense id, in order of first appearance. Interned bytes are copied into the allocator
+// and null terminated, so later phases compare and hash symbols as integers and still print them as strings
+struct StringInterner {
+  void init() {
+    INIT_MEMCHECK
+    symbols.init();
+    strings.init();
+  }
+
+  u32 intern(Allocator *allocator, StringRef string) {
+    ASSERT_MEMCHECK
+    InternedString interned{string, u32(strings.length)};
+    auto *existing = symbols.get(interned);
+    if (existing) return existing->id;
+
+    auto *bytes = allocator->construct<char>(string.len + 1);
+    memcpy(bytes, string.str, usize(string.len));
+    bytes[string.len] = '\0';
+    interned.string   = {bytes, string.len};
+    symbols.insert(allocator, interned);
+    strings.push_back(allocator, interned.string);
+    return interned.id;
+  }
+
+  // Looks up a string without interning it
+  bool find(StringRef string, u32 *id) {
+    ASSERT_MEMCHECK
+    auto *existing = symbols.get({string, 0});
+    if (!existing) return false;
+    *id = existing->id;
+    return true;
+  }
+
+  StringRef get(u32 id) {
+    ASSERT_MEMCHECK
+    return strings.get(i32(id));
+  }
+
+  i32 size() {
+    ASSERT_MEMCHECK
+    return strings.length;
+  }
+
+  Set<InternedString> symbols;
+  Vec<StringRef> strings; // Indexed by id
+  DEFINE_MEMCHECK
+};
+
+} // namespace ucl
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef COMMON_ADT_SWISS_SET_HPP
+#define COMMON_ADT_SWISS_SET_HPP
+
+#include "common/adt/hash.hpp"
+#include "common/general.hpp"
+#include "common/mem.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ucl {
+
+namespace impl {
+
+// Control bytes of a group of slots, compared all at once
+struct ControlGroup {
+  // Full slots hold 7 bits of their hash, so only empty and deleted slots have the high bit set
+  static const u8 empty   = 0x80;
+  static const u8 deleted = 0xFE;
+
+#if defined(__AVX2__)
+  static const i32 width = 32;
+
+  // Bit i is set when control byte i equals tag
+  static u32 match(const u8 *control, u8 tag) {
+    __m256i group = _mm256_loadu_si256((const __m256i *)control);
+    return u32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(char(tag)))));
+  }
+
+  // Bit i is set when slot i is empty or deleted
+  static u32 match_free(const u8 *control) {
+    return u32(_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)control)));
+  }
+#elif defined(__SSE2__)
+  static const i32 width = 16;
+
+  static u32 match(const u8 *control, u8 tag) {
+    __m128i group = _mm_loadu_si128((const __m128i *)control);
+    return u32(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(char(tag)))));
+  }
+
+  static u32 match_free(const u8 *control) { return u32(_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)control))); }
+#else
+  static const i32 width = 16;
+
+  static u32 match(const u8 *control, u8 tag) {
+    u32 mask = 0;
+    for (i32 i = 0; i < width; ++i) mask |= u32(control[i] == tag) << i;
+    return mask;
+  }
+
+  static u32 match_free(const u8 *control) {
+    u32 mask = 0;
+    for (i32 i = 0; i < width; ++i) mask |= u32(control[i] >> 7U) << i;
+    return mask;
+  }
+#endif
+
+  static u32 match_empty(const u8 *control) { return match(control, empty); }
+};
+
+// Hashtable probing groups of control bytes, each holding 7 bits of the hash of its slot. A lookup only compares
+// the keys of slots whose control byte matches, and stops at the first group with an empty slot. Erased slots in
+// a group without empty slots become tombstones so probes keep passing through the group
+template <typename T, typename H, typename E>
+struct SwissSet {
+  using Hash  = H;
+  using Equal = E;
+
+  using SetT = SwissSet<T, H, E>;
+
+  static constexpr bool cache_hash = CachesHash<Hash>::value;
+
+  struct Iterator {
+    T &operator*() const { return parent->slots[index]; }
+
+    T *operator->() const { return &parent->slots[index]; }
+
+    Iterator &operator++() {
+      index = parent->get_valid_entry_index(index + 1);
+      return *this;
+    }
+
+    friend bool operator==(const Iterator &it1, const Iterator &it2) {
+      assert(it1.parent == it2.parent);
+      return it1.index == it2.index;
+    }
+
+    friend bool operator!=(const Iterator &it1, const Iterator &it2) {
+      assert(it1.parent == it2.parent);
+      return it1.index != it2.index;
+    }
+
+    i32 index;
+    SetT *parent;
+  };
+
+  void init() {
+    INIT_MEMCHECK
+    control       = nullptr;
+    slots         = nullptr;
+    hashes        = nullptr;
+    length        = 0;
+    deleted_count = 0;
+    capacity      = 0;
+  }
+
+  void clear() {
+    ASSERT_MEMCHECK
+    length        = 0;
+    deleted_count = 0;
+    if (control) memset(control, ControlGroup::empty, usize(capacity));
+  }
+
+  i32 get_valid_entry_index(i32 index) {
+    ASSERT_MEMCHECK
+    while (index < capacity && (control[index] & ControlGroup::empty)) index++;
+    return index;
+  }
+
+  Iterator begin() {
+    ASSERT_MEMCHECK
+    return {get_valid_entry_index(0), this};
+  }
+
+  Iterator end() {
+    ASSERT_MEMCHECK
+    return {capacity, this};
+  }
+
+  // The hash is spread over 64 bits, the top 7 bits become the control byte and the upper half picks the group
+  static u64 mix_hash(T &data) { return u64(u32(Hash()(data))) * 0x9E3779B97F4A7C15ULL; }
+
+  static u8 control_tag(u64 hash) { return u8(hash >> 57U); }
+
+  // Cached hashes rule out slots whose 7 bit tag matched by chance without calling the equal function
+  bool slot_matches(i32 index, T &data, u64 hash) {
+    if constexpr (cache_hash) {
+      if (hashes[index] != hash) return false;
+    }
+    return Equal()(slots[index], data);
+  }
+
+  u64 slot_hash(i32 index) {
+    if constexpr (cache_hash) {
+      return hashes[index];
+    } else {
+      return mix_hash(slots[index]);
+    }
+  }
+
+  // Groups are visited at triangular offsets, which reaches every group of a power of two table
+  T *find(T &data, u64 hash) {
+    if (!capacity) return nullptr;
+    u8 tag          = control_tag(hash);
+    i32 group_mask  = capacity / ControlGroup::width - 1;
+    i32 group_index = i32(hash >> 32U) & group_mask;
+    for (i32 step = 1;; ++step) {
+      u8 *group = &control[group_index * ControlGroup::width];
+      for (u32 matches = ControlGroup::match(group, tag); matches; matches &= matches - 1) {
+        i32 index = group_index * ControlGroup::width + __builtin_ctz(matches);
+        if (slot_matches(index, data, hash)) return &slots[index];
+      }
+      if (ControlGroup::match_empty(group)) return nullptr;
+      group_index = (group_index + step) & group_mask;
+    }
+  }
+
+  // First empty or deleted slot along the probe sequence
+  i32 find_free_slot(u64 hash) {
+    i32 group_mask  = capacity / ControlGroup::width - 1;
+    i32 group_index = i32(hash >> 32U) & group_mask;
+    for (i32 step = 1;; ++step) {
+      u32 free_slots = ControlGroup::match_free(&control[group_index * ControlGroup::width]);
+      if (free_slots) return group_index * ControlGroup::width + __builtin_ctz(free_slots);
+      group_index = (group_index + step) & group_mask;
+    }
+  }
+
+  // Rehashing also drops every tombstone
+  void rehash(Allocator *allocator, i32 new_capacity) {
+    ASSERT_MEMCHECK
+    SetT old_set     = *this;
+    i32 old_capacity = capacity;
+
+    capacity = new_capacity;
+    control  = allocator->construct<u8>(capacity);
+    slots    = allocator->construct<T>(capacity);
+    if constexpr (cache_hash) hashes = allocator->construct<u64>(capacity);
+    clear();
+
+    for (i32 i = 0; i < old_capacity; ++i) {
+      if (old_set.control[i] & ControlGroup::empty) continue;
+      u64 hash       = old_set.slot_hash(i);
+      i32 index      = find_free_slot(hash);
+      control[index] = old_set.control[i];
+      slots[index]   = old_set.slots[i];
+      if constexpr (cache_hash) hashes[index] = hash;
+      ++length;
+    }
+    if (old_set.control) {
+      if constexpr (cache_hash) allocator->discard(old_set.hashes, old_capacity);
+      allocator->discard(old_set.slots, old_capacity);
+      allocator->discard(old_set.control, old_capacity);
+    }
+  }
+
+  T *insert(Allocator *allocator, T &data) {
+    ASSERT_MEMCHECK
+    u64 hash             = mix_hash(data);
+    auto *existing_entry = find(data, hash);
+    if (existing_entry) return existing_entry;
+
+    // Load factor of 7/8 counting tombstones keeps an empty slot in every probe sequence. When tombstones make up
+    // most of the load the table is rehashed at the same size
+    if (length + deleted_count + 1 > capacity - capacity / 8) {
+      if (length + 1 <= (capacity - capacity / 8) / 2) {
+        rehash(allocator, capacity);
+      } else {
+        rehash(allocator, capacity ? capacity << 1 : ControlGroup::width);
+      }
+    }
+
+    i32 index = find_free_slot(hash);
+    if (control[index] == ControlGroup::deleted) --deleted_count;
+    control[index] = control_tag(hash);
+    slots[index]   = data;
+    if constexpr (cache_hash) hashes[index] = hash;
+    ++length;
+    return nullptr;
+  }
+
+  T *get(T &data) {
+    ASSERT_MEMCHECK
+    return find(data, mix_hash(data));
+  }
+
+  bool erase(T &data) {
+    ASSERT_MEMCHECK
+    auto *entry = find(data, mix_hash(data));
+    if (!entry) return false;
+
+    // A group with an empty slot never had a probe pass through it, so its slot can become empty again
+    i32 index     = i32(entry - slots);
+    auto *group   = &control[index / ControlGroup::width * ControlGroup::width];
+    bool is_empty = ControlGroup::match_empty(group);
+    if (!is_empty) ++deleted_count;
+    control[index] = is_empty ? ControlGroup::empty : ControlGroup::deleted;
+    --length;
+    return true;
+  }
+
+  bool erase(T &&data) { return erase(data); }
+
+  // Rehashes into the smallest table which holds the entries at the load factor
+  void shrink_to_fit(Allocator *allocator) {
+    ASSERT_MEMCHECK
+    i32 new_capacity = ControlGroup::width;
+    while (length + 1 > new_capacity - new_capacity / 8) new_capacity <<= 1;
+    if (new_capacity < capacity || deleted_count) rehash(allocator, new_capacity);
+  }
+
+  T *get(T &&data) { return get(data); }
+
+  bool has(T &data) { return get(data); }
+
+  bool has(T &&data) { return get(data); }
+
+  u8 *control; // One byte per slot, empty, deleted or the tag of the full slot
+  T *slots;
+  u64 *hashes; // Mixed hash of each slot, only allocated when cache_hash is set
+  i32 length;
+  i32 deleted_count;
+  i32 capacity;
+  DEFINE_MEMCHECK
+};
+
+} // namespace impl
+
+template <typename T>
+using SwissSet = impl::SwissSet<T, HashFn<T>, EqualFn<T>>;
+
+} // namespace ucl
+
+#endif
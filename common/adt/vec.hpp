@@ -48,18 +48,27 @@ struct Vec {
     ASSERT_MEMCHECK
     assert(new_capacity >= 0);
     if (capacity < new_capacity) {
-      while (capacity < new_capacity) {
+      i32 grown_capacity = capacity;
+      while (grown_capacity < new_capacity) {
         // cap = cap * 1.5 + 8
-        capacity = (capacity << 1) - (capacity >> 1) + 8;
+        grown_capacity = (grown_capacity << 1) - (grown_capacity >> 1) + 8;
       }
-      resize(allocator, capacity);
+      resize(allocator, grown_capacity);
     }
   }
 
   void resize(Allocator *allocator, i32 new_capacity) {
     ASSERT_MEMCHECK
+    if (allocator->try_extend(data, capacity, new_capacity)) {
+      capacity = new_capacity;
+      return;
+    }
+
     T *new_data = allocator->construct<T>(new_capacity);
-    if (data) memory_copy(new_data, data, length);
+    if (data) {
+      memory_copy(new_data, data, length);
+      allocator->discard(data, capacity);
+    }
     data     = new_data;
     capacity = new_capacity;
   }
@@ -0,0 +1,129 @@
+#include "common/lexer/codegen.hpp"
+
+namespace ucl {
+
+void emit_byte(FILE *out, u32 byte) {
+  if (byte > ' ' && byte < 127 && byte != '\'' && byte != '\\') {
+    fprintf(out, "'%c'", byte);
+  } else {
+    fprintf(out, "%u", byte);
+  }
+}
+
+// Emits a condition on the variable c which is true for every byte that stays in the state
+void emit_self_loop_condition(FILE *out, DFA *dfa, u32 state) {
+  bool first_run = true;
+  u32 byte       = 0;
+  while (byte < DFA::alphabet_size) {
+    if (dfa->next_state(state, u8(byte)) != state) {
+      ++byte;
+      continue;
+    }
+    u32 run_end = byte + 1;
+    while (run_end < DFA::alphabet_size && dfa->next_state(state, u8(run_end)) == state) ++run_end;
+
+    if (!first_run) fprintf(out, " || ");
+    first_run = false;
+    if (run_end - byte == 1) {
+      fprintf(out, "c == ");
+      emit_byte(out, byte);
+    } else if (byte == 0) {
+      fprintf(out, "c <= ");
+      emit_byte(out, run_end - 1);
+    } else if (run_end == DFA::alphabet_size) {
+      fprintf(out, "c >= ");
+      emit_byte(out, byte);
+    } else {
+      fprintf(out, "(c >= ");
+      emit_byte(out, byte);
+      fprintf(out, " && c <= ");
+      emit_byte(out, run_end - 1);
+      fprintf(out, ")");
+    }
+    byte = run_end;
+  }
+}
+
+void emit_state(FILE *out, DFA *dfa, u32 state) {
+  fprintf(out, "s%u:\n", state);
+
+  bool has_self_loop = false;
+  for (u32 byte = 0; byte < DFA::alphabet_size; ++byte) {
+    if (dfa->next_state(state, u8(byte)) == state) has_self_loop = true;
+  }
+
+  // Self loops such as identifier bodies and whitespace are consumed by a tight inner loop
+  if (has_self_loop) {
+    fprintf(out, "  while (current != end) {\n");
+    fprintf(out, "    u8 c = u8(*current);\n");
+    fprintf(out, "    if (!(");
+    emit_self_loop_condition(out, dfa, state);
+    fprintf(out, ")) break;\n");
+    fprintf(out, "    ++current;\n");
+    fprintf(out, "  }\n");
+  }
+
+  if (dfa->accept_tokens[state] != FANode::no_accept) {
+    // The start state is entered once before consuming anything, an empty match is not a token
+    if (state == dfa->start_state) {
+      fprintf(out, "  if (current != start) {\n");
+      fprintf(out, "    accept_token = %u;\n", dfa->accept_tokens[state]);
+      fprintf(out, "    accept_end   = current;\n");
+      fprintf(out, "  }\n");
+    } else {
+      fprintf(out, "  accept_token = %u;\n", dfa->accept_tokens[state]);
+      fprintf(out, "  accept_end   = current;\n");
+    }
+  }
+
+  fprintf(out, "  if (current == end) goto done;\n");
+  fprintf(out, "  switch (u8(*current++)) {\n");
+  for (u32 next_state = 1; next_state < dfa->state_count; ++next_state) {
+    if (next_state == state) continue;
+
+    bool has_case = false;
+    for (u32 byte = 0; byte < DFA::alphabet_size; ++byte) {
+      if (dfa->next_state(state, u8(byte)) != next_state) continue;
+      fprintf(out, has_case ? " " : "  ");
+      fprintf(out, "case ");
+      emit_byte(out, byte);
+      fprintf(out, ":");
+      has_case = true;
+    }
+    if (has_case) fprintf(out, " goto s%u;\n", next_state);
+  }
+  fprintf(out, "  default: goto done;\n");
+  fprintf(out, "  }\n");
+}
+
+void emit_scanner_source(FILE *out, DFA *dfa, cstr function_name) {
+  fprintf(out, "// Generated by the ucl lexer code generator, do not edit\n");
+  fprintf(out, "#include \"common/lexer/scanner.hpp\"\n");
+  fprintf(out, "\n");
+  fprintf(out, "bool %s(ucl::Scanner *scanner, ucl::Token *token) {\n", function_name);
+  fprintf(out, "  cstr start = scanner->current;\n");
+  fprintf(out, "  cstr end   = scanner->end;\n");
+  fprintf(out, "  if (start == end) return false;\n");
+  fprintf(out, "\n");
+  fprintf(out, "  cstr current     = start;\n");
+  fprintf(out, "  u32 accept_token = ucl::FANode::no_accept;\n");
+  fprintf(out, "  cstr accept_end  = start + 1;\n");
+  fprintf(out, "  goto s%u;\n", dfa->start_state);
+  fprintf(out, "\n");
+
+  for (u32 state = 1; state < dfa->state_count; ++state) {
+    emit_state(out, dfa, state);
+    fprintf(out, "\n");
+  }
+
+  fprintf(out, "done:\n");
+  fprintf(out, "  token->accept_token    = accept_token;\n");
+  fprintf(out, "  token->text.str        = start;\n");
+  fprintf(out, "  token->text.len        = i32(accept_end - start);\n");
+  fprintf(out, "  scanner->current       = accept_end;\n");
+  fprintf(out, "  scanner->lookahead_end = current;\n");
+  fprintf(out, "  return true;\n");
+  fprintf(out, "}\n");
+}
+
+} // namespace ucl
@@ -0,0 +1,14 @@
+#ifndef COMMON_LEXER_CODEGEN_HPP
+#define COMMON_LEXER_CODEGEN_HPP
+
+#include "common/general.hpp"
+#include "common/lexer/dfa.hpp"
+
+namespace ucl {
+
+// Writes the dfa as a direct coded C++ scanner with the same contract as next_token
+void emit_scanner_source(FILE *out, DFA *dfa, cstr function_name);
+
+} // namespace ucl
+
+#endif
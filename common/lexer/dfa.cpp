@@ -0,0 +1,402 @@
+#include "common/lexer/dfa.hpp"
+
+#include "common/adt/map.hpp"
+#include "common/adt/vec.hpp"
+
+namespace ucl {
+
+AllocationSite dfa_table_site{"dfa_tables", 0};
+
+struct SubsetConstruction {
+  FAContext *fa_context;
+  FrozenGraph<FANode, FAEdge> nfa; // Node ids are the ids of the reduced nfa
+  u32 class_count;
+
+  SwissMap<NFAStateSet, u32> dfa_states;
+  Vec<NFAStateSet> state_sets;
+
+  Vec<u32> transitions;
+  Vec<u32> accept_tokens;
+};
+
+i32 compare_ids(const void *id1, const void *id2) { return *(const i32 *)id1 - *(const i32 *)id2; }
+
+void sort_unique_ids(Vec<i32> *ids) {
+  if (ids->length == 0) return;
+  qsort(ids->data, usize(ids->length), sizeof(i32), compare_ids);
+  i32 unique_length = 1;
+  for (i32 i = 1; i < ids->length; ++i) {
+    if (ids->data[i] != ids->data[unique_length - 1]) ids->data[unique_length++] = ids->data[i];
+  }
+  ids->length = unique_length;
+}
+
+u32 accept_token_of(FrozenGraph<FANode, FAEdge> *nfa, NFAStateSet *set) {
+  FANode *accept_node = nullptr;
+  for (i32 i = 0; i < set->length; ++i) {
+    auto *node = &nfa->nodes[set->ids[i]];
+    if (node->accept_token == FANode::no_accept) continue;
+    if (!accept_node || node->accepts_before(accept_node)) accept_node = node;
+  }
+  return accept_node ? accept_node->accept_token : FANode::no_accept;
+}
+
+u32 add_dfa_state(SubsetConstruction *construction, NFAStateSet *set) {
+  auto *allocator = &construction->fa_context->scratch_allocator;
+
+  auto *existing_state = construction->dfa_states.get(*set);
+  if (existing_state) return *existing_state;
+
+  NFAStateSet key;
+  key.length = set->length;
+  key.ids    = allocator->construct<i32>(set->length);
+  memory_copy(key.ids, set->ids, set->length);
+
+  u32 accept_token = accept_token_of(&construction->nfa, &key);
+
+  auto new_state = u32(construction->state_sets.length);
+  construction->dfa_states.insert(allocator, key, new_state);
+  construction->state_sets.push_back(allocator, key);
+  construction->accept_tokens.push_back(allocator, accept_token);
+
+  auto class_count = i32(construction->class_count);
+  construction->transitions.reserve(allocator, construction->transitions.length + class_count);
+  memory_clear(&construction->transitions.data[construction->transitions.length], class_count);
+  construction->transitions.length += class_count;
+  return new_state;
+}
+
+u32 compute_byte_classes(FrozenGraph<FANode, FAEdge> *nfa, u8 *class_map) {
+  u32 class_of[DFA::alphabet_size];
+  u32 class_size[DFA::alphabet_size];
+  u32 class_hits[DFA::alphabet_size];
+  u32 class_split[DFA::alphabet_size];
+  u32 touched_classes[DFA::alphabet_size];
+
+  u32 class_count = 1;
+  class_size[0]   = DFA::alphabet_size;
+  class_hits[0]   = 0;
+  for (u32 byte = 0; byte < DFA::alphabet_size; ++byte) class_of[byte] = 0;
+
+  // Every edge splits the classes it only partially covers
+  for (u32 edge_index = 0; edge_index < nfa->edge_count; ++edge_index) {
+    auto *edge = &nfa->edges[edge_index];
+    if (edge->is_epsilon()) continue;
+    u32 first = edge->first;
+    u32 last  = edge->last;
+
+    u32 touched_count = 0;
+    for (u32 byte = first; byte <= last; ++byte) {
+      if (class_hits[class_of[byte]]++ == 0) touched_classes[touched_count++] = class_of[byte];
+    }
+
+    for (u32 i = 0; i < touched_count; ++i) {
+      u32 byte_class          = touched_classes[i];
+      class_split[byte_class] = byte_class;
+      if (class_hits[byte_class] < class_size[byte_class]) {
+        class_split[byte_class] = class_count;
+        class_size[class_count] = class_hits[byte_class];
+        class_hits[class_count] = 0;
+        class_size[byte_class] -= class_hits[byte_class];
+        ++class_count;
+      }
+      class_hits[byte_class] = 0;
+    }
+
+    for (u32 byte = first; byte <= last; ++byte) class_of[byte] = class_split[class_of[byte]];
+  }
+
+  // Renumber classes in order of their smallest byte
+  u32 renumbered[DFA::alphabet_size];
+  for (u32 byte_class = 0; byte_class < class_count; ++byte_class) renumbered[byte_class] = u32(-1);
+  u32 renumbered_count = 0;
+  for (u32 byte = 0; byte < DFA::alphabet_size; ++byte) {
+    if (renumbered[class_of[byte]] == u32(-1)) renumbered[class_of[byte]] = renumbered_count++;
+    class_map[byte] = u8(renumbered[class_of[byte]]);
+  }
+  return renumbered_count;
+}
+
+Result determinize_nfa(FAContext *fa_context, Allocator *allocator, DFA *dfa) {
+  auto *temp_allocator = &fa_context->scratch_allocator;
+  BumpScope construction_scope(temp_allocator);
+
+  // Subset construction only reads the nfa, so it walks a packed copy
+  SubsetConstruction construction;
+  construction.nfa = fa_context->graph.freeze(temp_allocator);
+
+  dfa->class_count = compute_byte_classes(&construction.nfa, dfa->class_map);
+
+  construction.fa_context  = fa_context;
+  construction.class_count = dfa->class_count;
+  construction.dfa_states.init();
+  construction.state_sets.init();
+  construction.transitions.init();
+  construction.accept_tokens.init();
+
+  NFAStateSet dead_set{nullptr, 0};
+  if (add_dfa_state(&construction, &dead_set) != DFA::dead_state) panic("Dead state must be the first dfa state\n");
+
+  i32 entry_id = fa_context->entry_node->data.id;
+  NFAStateSet entry_set{&entry_id, 1};
+  u32 start_state = add_dfa_state(&construction, &entry_set);
+
+  // Destination node ids grouped by the byte class of the edge which reaches them
+  Vec<i32> class_destinations[DFA::alphabet_size];
+  for (auto &destinations : class_destinations) destinations.init();
+
+  // A range may cover one class in several pieces, the stamp keeps an edge from adding a destination twice
+  u32 class_stamp[DFA::alphabet_size] = {};
+  u32 edge_stamp                      = 0;
+
+  for (i32 state = 1; state < construction.state_sets.length; ++state) {
+    for (auto &destinations : class_destinations) destinations.clear();
+
+    auto set = construction.state_sets.get(state);
+    for (i32 i = 0; i < set.length; ++i) {
+      for (auto *edge : construction.nfa.edges_of(u32(set.ids[i]))) {
+        if (edge->is_epsilon()) continue;
+        ++edge_stamp;
+        for (u32 byte = edge->first; byte <= edge->last; ++byte) {
+          u32 byte_class = dfa->class_map[byte];
+          if (class_stamp[byte_class] == edge_stamp) continue;
+          class_stamp[byte_class] = edge_stamp;
+          class_destinations[byte_class].push_back(temp_allocator, i32(construction.nfa.destination(edge)));
+        }
+      }
+    }
+
+    for (u32 byte_class = 0; byte_class < dfa->class_count; ++byte_class) {
+      auto *destinations = &class_destinations[byte_class];
+      if (destinations->length == 0) continue;
+
+      sort_unique_ids(destinations);
+      NFAStateSet destination_set{destinations->data, destinations->length};
+      u32 next_state = add_dfa_state(&construction, &destination_set);
+      construction.transitions.data[u32(state) * dfa->class_count + byte_class] = next_state;
+    }
+  }
+
+  dfa->state_count   = u32(construction.state_sets.length);
+  dfa->start_state   = start_state;
+  dfa->transitions   = allocator->construct<u32>(construction.transitions.length, &dfa_table_site);
+  dfa->accept_tokens = allocator->construct<u32>(construction.accept_tokens.length, &dfa_table_site);
+  memory_copy(dfa->transitions, construction.transitions.data, construction.transitions.length);
+  memory_copy(dfa->accept_tokens, construction.accept_tokens.data, construction.accept_tokens.length);
+  return ok;
+}
+
+// Hopcroft partition refinement over the blocks of equivalent states
+struct Partition {
+  u32 *elements;     // States ordered by block
+  u32 *location;     // Index of each state into elements
+  u32 *block_of;     // Block of each state
+  u32 *block_first;  // First element index of each block
+  u32 *block_end;    // One past the last element index of each block
+  u32 *block_marked; // Number of marked states at the front of each block
+  u32 block_count;
+};
+
+void mark_state(Partition *partition, u32 state) {
+  u32 block    = partition->block_of[state];
+  u32 position = partition->location[state];
+  u32 marked   = partition->block_first[block] + partition->block_marked[block];
+  if (position < marked) return;
+
+  u32 other_state                  = partition->elements[marked];
+  partition->elements[marked]      = state;
+  partition->elements[position]    = other_state;
+  partition->location[state]       = marked;
+  partition->location[other_state] = position;
+  ++partition->block_marked[block];
+}
+
+void minimize_dfa(Allocator *scratch_allocator, DFA *dfa) {
+  BumpScope minimize_scope(scratch_allocator);
+
+  u32 state_count = dfa->state_count;
+  u32 class_count = dfa->class_count;
+
+  Partition partition;
+  partition.elements     = scratch_allocator->construct<u32>(state_count);
+  partition.location     = scratch_allocator->construct<u32>(state_count);
+  partition.block_of     = scratch_allocator->construct<u32>(state_count);
+  partition.block_first  = scratch_allocator->construct<u32>(state_count);
+  partition.block_end    = scratch_allocator->construct<u32>(state_count);
+  partition.block_marked = scratch_allocator->construct<u32>(state_count);
+  partition.block_count  = 0;
+
+  // Initial partition groups states by accept token
+  Map<i32, u32> token_blocks;
+  token_blocks.init();
+  auto *block_sizes = scratch_allocator->construct<u32>(state_count);
+  for (u32 state = 0; state < state_count; ++state) {
+    auto *block = token_blocks.get(i32(dfa->accept_tokens[state]));
+    if (!block) {
+      block_sizes[partition.block_count] = 0;
+      token_blocks.insert(scratch_allocator, i32(dfa->accept_tokens[state]), partition.block_count);
+      block = token_blocks.get(i32(dfa->accept_tokens[state]));
+      ++partition.block_count;
+    }
+    partition.block_of[state] = *block;
+    ++block_sizes[*block];
+  }
+
+  u32 offset = 0;
+  for (u32 block = 0; block < partition.block_count; ++block) {
+    partition.block_first[block]  = offset;
+    partition.block_end[block]    = offset;
+    partition.block_marked[block] = 0;
+    offset += block_sizes[block];
+  }
+  for (u32 state = 0; state < state_count; ++state) {
+    u32 position                 = partition.block_end[partition.block_of[state]]++;
+    partition.elements[position] = state;
+    partition.location[state]    = position;
+  }
+
+  // Inverse transitions in compressed rows, indexed by symbol * state_count + destination
+  u32 inverse_count   = state_count * class_count;
+  auto *inverse_first = scratch_allocator->construct<u32>(inverse_count + 1);
+  auto *inverse       = scratch_allocator->construct<u32>(inverse_count);
+  memory_clear(inverse_first, i32(inverse_count + 1));
+  for (u32 state = 0; state < state_count; ++state) {
+    for (u32 symbol = 0; symbol < class_count; ++symbol) {
+      ++inverse_first[symbol * state_count + dfa->transitions[state * class_count + symbol] + 1];
+    }
+  }
+  for (u32 i = 0; i < inverse_count; ++i) inverse_first[i + 1] += inverse_first[i];
+  auto *inverse_fill = scratch_allocator->construct<u32>(inverse_count);
+  memory_copy(inverse_fill, inverse_first, i32(inverse_count));
+  for (u32 state = 0; state < state_count; ++state) {
+    for (u32 symbol = 0; symbol < class_count; ++symbol) {
+      inverse[inverse_fill[symbol * state_count + dfa->transitions[state * class_count + symbol]]++] = state;
+    }
+  }
+
+  // Worklist of (block, symbol) splitters
+  Vec<u32> worklist;
+  worklist.init();
+  auto *in_worklist = scratch_allocator->construct<bool>(state_count * class_count);
+  memory_clear(in_worklist, i32(state_count * class_count));
+  for (u32 block = 0; block < partition.block_count; ++block) {
+    for (u32 symbol = 0; symbol < class_count; ++symbol) {
+      worklist.push_back(scratch_allocator, block * class_count + symbol);
+      in_worklist[block * class_count + symbol] = true;
+    }
+  }
+
+  Vec<u32> splitter_states;
+  splitter_states.init();
+  Vec<u32> touched_blocks;
+  touched_blocks.init();
+  while (worklist.length > 0) {
+    u32 splitter = worklist.back();
+    worklist.pop_back();
+    in_worklist[splitter] = false;
+
+    u32 splitter_block = splitter / class_count;
+    u32 symbol         = splitter % class_count;
+
+    // Marking reorders elements, so the splitter block is copied out before walking its predecessors
+    splitter_states.clear();
+    for (u32 i = partition.block_first[splitter_block]; i < partition.block_end[splitter_block]; ++i) {
+      splitter_states.push_back(scratch_allocator, partition.elements[i]);
+    }
+
+    touched_blocks.clear();
+    for (auto *destination : splitter_states) {
+      u32 row = symbol * state_count + *destination;
+      for (u32 k = inverse_first[row]; k < inverse_first[row + 1]; ++k) {
+        u32 block = partition.block_of[inverse[k]];
+        if (partition.block_marked[block] == 0) touched_blocks.push_back(scratch_allocator, block);
+        mark_state(&partition, inverse[k]);
+      }
+    }
+
+    for (auto *touched_block : touched_blocks) {
+      u32 block  = *touched_block;
+      u32 marked = partition.block_marked[block];
+      u32 first  = partition.block_first[block];
+      u32 end    = partition.block_end[block];
+      partition.block_marked[block] = 0;
+      if (marked == end - first) continue;
+
+      // Marked states move into a new block at the front of the old one
+      u32 new_block                     = partition.block_count++;
+      partition.block_first[new_block]  = first;
+      partition.block_end[new_block]    = first + marked;
+      partition.block_marked[new_block] = 0;
+      partition.block_first[block]      = first + marked;
+      for (u32 i = first; i < first + marked; ++i) partition.block_of[partition.elements[i]] = new_block;
+
+      u32 smaller_block = marked <= end - first - marked ? new_block : block;
+      for (u32 next_symbol = 0; next_symbol < class_count; ++next_symbol) {
+        u32 old_splitter = block * class_count + next_symbol;
+        u32 new_splitter = (in_worklist[old_splitter] ? new_block : smaller_block) * class_count + next_symbol;
+        if (!in_worklist[new_splitter]) {
+          worklist.push_back(scratch_allocator, new_splitter);
+          in_worklist[new_splitter] = true;
+        }
+      }
+    }
+  }
+
+  // Renumber blocks so the dead state stays at 0 and states keep their relative order. A block is numbered at its
+  // first state, so its new row never lies after that state's row and the tables are rewritten in place
+  auto *block_state = scratch_allocator->construct<u32>(partition.block_count);
+  for (u32 block = 0; block < partition.block_count; ++block) block_state[block] = u32(-1);
+  u32 minimized_count = 0;
+  for (u32 state = 0; state < state_count; ++state) {
+    u32 block = partition.block_of[state];
+    if (block_state[block] == u32(-1)) block_state[block] = minimized_count++;
+  }
+
+  for (u32 state = 0, new_state = 0; state < state_count; ++state) {
+    if (block_state[partition.block_of[state]] != new_state) continue;
+
+    dfa->accept_tokens[new_state] = dfa->accept_tokens[state];
+    for (u32 symbol = 0; symbol < class_count; ++symbol) {
+      u32 next_block = partition.block_of[dfa->transitions[state * class_count + symbol]];
+      dfa->transitions[new_state * class_count + symbol] = block_state[next_block];
+    }
+    ++new_state;
+  }
+
+  dfa->start_state = block_state[partition.block_of[dfa->start_state]];
+  dfa->state_count = minimized_count;
+}
+
+void dump_dfa(FILE *out, DFA *dfa) {
+  fprintf(out, "digraph G {\n");
+  for (u32 state = 1; state < dfa->state_count; ++state) {
+    fprintf(out, "  s%u[shape=%s", state, dfa->accept_tokens[state] != FANode::no_accept ? "doublecircle" : "circle");
+    if (dfa->accept_tokens[state] != FANode::no_accept) {
+      fprintf(out, ",label=\"s%u\\n%u\"", state, dfa->accept_tokens[state]);
+    }
+    if (state == dfa->start_state) fprintf(out, ",style=bold");
+    fprintf(out, "]\n");
+
+    // Runs of consecutive symbols with the same destination share one edge
+    u32 symbol = 0;
+    while (symbol < DFA::alphabet_size) {
+      u32 next_state = dfa->next_state(state, u8(symbol));
+      u32 run_end    = symbol + 1;
+      while (run_end < DFA::alphabet_size && dfa->next_state(state, u8(run_end)) == next_state) ++run_end;
+
+      if (next_state != DFA::dead_state) {
+        fprintf(out, "  s%u->s%u[label=\"", state, next_state);
+        dump_symbol(out, u8(symbol));
+        if (run_end - 1 != symbol) {
+          fprintf(out, "-");
+          dump_symbol(out, u8(run_end - 1));
+        }
+        fprintf(out, "\"]\n");
+      }
+      symbol = run_end;
+    }
+  }
+  fprintf(out, "}\n");
+}
+
+} // namespace ucl
@@ -0,0 +1,75 @@
+#ifndef COMMON_LEXER_DFA_HPP
+#define COMMON_LEXER_DFA_HPP
+
+#include "common/adt/hash.hpp"
+#include "common/adt/vec.hpp"
+#include "common/general.hpp"
+#include "common/lexer/lexer.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Dense deterministic automaton. State 0 is the dead state and only transitions to itself
+struct DFA {
+  static const u32 dead_state    = 0;
+  static const u32 alphabet_size = 256;
+
+  u32 next_state(u32 state, u8 byte) { return transitions[state * class_count + class_map[byte]]; }
+
+  u32 state_count;
+  u32 start_state;
+
+  // Bytes which no edge tells apart share one equivalence class and one table column
+  u32 class_count;
+  u8 class_map[alphabet_size];
+
+  u32 *transitions; // Indexed by state * class_count + class
+  u32 *accept_tokens;
+};
+
+// Transition and accept tables of every automaton
+extern AllocationSite dfa_table_site;
+
+// Sorted list of nfa node ids which together form a single dfa state
+struct NFAStateSet {
+  i32 *ids;
+  i32 length;
+};
+
+template <>
+struct HashFn<NFAStateSet> {
+  static constexpr bool cache_hash = true;
+
+  HashValue operator()(NFAStateSet set) { return fold_hash(hash_memory(set.ids, usize(set.length) * sizeof(i32))); }
+};
+
+template <>
+struct EqualFn<NFAStateSet> {
+  bool operator()(NFAStateSet set1, NFAStateSet set2) {
+    if (set1.length != set2.length) return false;
+    for (i32 i = 0; i < set1.length; ++i) {
+      if (set1.ids[i] != set2.ids[i]) return false;
+    }
+    return true;
+  }
+};
+
+// Turns collected destination ids into the canonical form of an NFAStateSet
+void sort_unique_ids(Vec<i32> *ids);
+
+// Token of the node which accepts first, FANode::no_accept when no node of the set accepts
+u32 accept_token_of(FrozenGraph<FANode, FAEdge> *nfa, NFAStateSet *set);
+
+// Partitions the byte alphabet by the edge symbols of the graph, returns the number of classes
+u32 compute_byte_classes(FrozenGraph<FANode, FAEdge> *nfa, u8 *class_map);
+
+Result determinize_nfa(FAContext *fa_context, Allocator *allocator, DFA *dfa);
+
+// Merges equivalent states in place, states with different accept tokens are never merged
+void minimize_dfa(Allocator *scratch_allocator, DFA *dfa);
+
+void dump_dfa(FILE *out, DFA *dfa);
+
+} // namespace ucl
+
+#endif
@@ -0,0 +1,128 @@
+#include "common/lexer/dfa_file.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ucl {
+
+Result write_all(i32 fd, const void *bytes, usize length) {
+  auto *data = (const u8 *)bytes;
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written <= 0) return err;
+    data += written;
+    length -= usize(written);
+  }
+  return ok;
+}
+
+Result write_dfa_file(cstr path, DFA *dfa, u64 spec_hash) {
+  usize transitions_size   = usize(dfa->state_count) * dfa->class_count * sizeof(u32);
+  usize accept_tokens_size = usize(dfa->state_count) * sizeof(u32);
+  usize file_size          = sizeof(DFAFileHeader) + transitions_size + accept_tokens_size;
+  if (file_size > u32(-1)) {
+    error("DFA is too large to be written to '%s'\n", path);
+    return err;
+  }
+
+  DFAFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic                = DFAFileHeader::magic_value;
+  header.version              = DFAFileHeader::version_value;
+  header.spec_hash            = spec_hash;
+  header.state_count          = dfa->state_count;
+  header.start_state          = dfa->start_state;
+  header.class_count          = dfa->class_count;
+  header.transitions_offset   = u32(sizeof(DFAFileHeader));
+  header.accept_tokens_offset = u32(sizeof(DFAFileHeader) + transitions_size);
+  header.file_size            = u32(file_size);
+  memcpy(header.class_map, dfa->class_map, sizeof(header.class_map));
+
+  // Written under a unique name and renamed so concurrent readers never see a partial file
+  char temp_path[4096];
+  snprintf(temp_path, sizeof(temp_path), "%s.%d.tmp", path, getpid());
+  i32 fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    error("Could not create '%s'\n", temp_path);
+    return err;
+  }
+
+  if (write_all(fd, &header, sizeof(header)) || write_all(fd, dfa->transitions, transitions_size) ||
+      write_all(fd, dfa->accept_tokens, accept_tokens_size)) {
+    error("Could not write '%s'\n", temp_path);
+    close(fd);
+    unlink(temp_path);
+    return err;
+  }
+  close(fd);
+
+  if (rename(temp_path, path) < 0) {
+    error("Could not rename '%s' to '%s'\n", temp_path, path);
+    unlink(temp_path);
+    return err;
+  }
+  return ok;
+}
+
+Result map_dfa_file(cstr path, u64 spec_hash, DFA *dfa, MappedDFA *mapped_dfa) {
+  i32 fd = open(path, O_RDONLY);
+  if (fd < 0) return err;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0 || usize(file_stat.st_size) < sizeof(DFAFileHeader)) {
+    close(fd);
+    return err;
+  }
+
+  auto length   = usize(file_stat.st_size);
+  void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return err;
+
+  auto *header = (const DFAFileHeader *)mapping;
+  usize transitions_size   = usize(header->state_count) * header->class_count * sizeof(u32);
+  usize accept_tokens_size = usize(header->state_count) * sizeof(u32);
+  if (header->magic != DFAFileHeader::magic_value || header->version != DFAFileHeader::version_value ||
+      header->spec_hash != spec_hash || header->file_size != length || header->class_count > DFA::alphabet_size ||
+      header->start_state >= header->state_count || header->transitions_offset % sizeof(u32) != 0 ||
+      header->accept_tokens_offset % sizeof(u32) != 0 || header->transitions_offset + transitions_size > length ||
+      header->accept_tokens_offset + accept_tokens_size > length) {
+    munmap(mapping, length);
+    return err;
+  }
+
+  // Loading stays a mapping plus checks of constant cost. The file is only ever replaced whole by a rename, so the
+  // transition targets are trusted and only checked entry by entry in debug builds
+  bool valid_tables = true;
+  for (u32 byte = 0; byte < DFA::alphabet_size; ++byte) valid_tables &= header->class_map[byte] < header->class_count;
+#if DEBUG
+  auto *transitions = (const u32 *)((const u8 *)mapping + header->transitions_offset);
+  for (usize i = 0; i < transitions_size / sizeof(u32); ++i) valid_tables &= transitions[i] < header->state_count;
+#endif
+  if (!valid_tables) {
+    munmap(mapping, length);
+    return err;
+  }
+
+  dfa->state_count   = header->state_count;
+  dfa->start_state   = header->start_state;
+  dfa->class_count   = header->class_count;
+  dfa->transitions   = (u32 *)((u8 *)mapping + header->transitions_offset);
+  dfa->accept_tokens = (u32 *)((u8 *)mapping + header->accept_tokens_offset);
+  memcpy(dfa->class_map, header->class_map, sizeof(dfa->class_map));
+
+  mapped_dfa->mapping = mapping;
+  mapped_dfa->length  = length;
+  return ok;
+}
+
+void unmap_dfa_file(MappedDFA *mapped_dfa) {
+  if (mapped_dfa->mapping) munmap(mapped_dfa->mapping, mapped_dfa->length);
+  mapped_dfa->mapping = nullptr;
+  mapped_dfa->length  = 0;
+}
+
+} // namespace ucl
@@ -0,0 +1,44 @@
+#ifndef COMMON_LEXER_DFA_FILE_HPP
+#define COMMON_LEXER_DFA_FILE_HPP
+
+#include "common/general.hpp"
+#include "common/lexer/dfa.hpp"
+
+namespace ucl {
+
+// On disk layout of a finished dfa. All arrays are addressed by byte offsets from the start of the
+// file so the file can be mapped anywhere and used without any fixups
+struct DFAFileHeader {
+  static const u32 magic_value   = 0x41464455; // "UDFA"
+  static const u32 version_value = 1;
+
+  u32 magic;
+  u32 version;
+  u64 spec_hash;
+
+  u32 state_count;
+  u32 start_state;
+  u32 class_count;
+
+  u32 transitions_offset;
+  u32 accept_tokens_offset;
+  u32 file_size;
+
+  u8 class_map[DFA::alphabet_size];
+};
+
+struct MappedDFA {
+  void *mapping;
+  usize length;
+};
+
+Result write_dfa_file(cstr path, DFA *dfa, u64 spec_hash);
+
+// The tables of the loaded dfa point into the read only mapping
+Result map_dfa_file(cstr path, u64 spec_hash, DFA *dfa, MappedDFA *mapped_dfa);
+
+void unmap_dfa_file(MappedDFA *mapped_dfa);
+
+} // namespace ucl
+
+#endif
@@ -0,0 +1,92 @@
+#include "common/lexer/incremental.hpp"
+
+namespace ucl {
+
+void push_token(Allocator *allocator, TokenStream *stream, Token *token, i32 lookahead_end) {
+  stream->tokens.push_back(allocator, *token);
+  stream->lookahead_ends.push_back(allocator, lookahead_end);
+}
+
+void lex_stream(Allocator *allocator, DFA *dfa, NextTokenFn next_token_fn, StringRef source, TokenStream *stream) {
+  stream->init();
+  stream->source = source;
+
+  Scanner scanner;
+  scanner.init(dfa, source.str, source.str + source.len);
+  Token token;
+  while (next_token_fn(&scanner, &token)) {
+    push_token(allocator, stream, &token, i32(scanner.lookahead_end - source.str));
+  }
+}
+
+i32 relex_stream(Allocator *allocator, DFA *dfa, NextTokenFn next_token_fn, TokenStream *old_stream, SourceEdit *edit,
+                 TokenStream *stream) {
+  auto *old_source = &old_stream->source;
+  i32 delta        = edit->inserted.len - edit->removed_length;
+  i32 edit_end     = edit->offset + edit->removed_length; // In old source offsets
+  assert(edit->offset >= 0 && edit_end <= old_source->len);
+
+  stream->init();
+  stream->source.len = old_source->len + delta;
+  char *new_source   = allocator->construct<char>(stream->source.len);
+  memory_copy(new_source, (char *)old_source->str, edit->offset);
+  memory_copy(new_source + edit->offset, (char *)edit->inserted.str, edit->inserted.len);
+  memory_copy(new_source + edit->offset + edit->inserted.len, (char *)old_source->str + edit_end,
+              old_source->len - edit_end);
+  stream->source.str = new_source;
+
+  // Tokens whose scan stopped short of the edit are unaffected. Reaching the edit offset itself counts as
+  // affected since scanning up to the end of the source may be extended by an insertion there
+  i32 old_count   = old_stream->tokens.length;
+  i32 first_dirty = 0;
+  while (first_dirty < old_count && old_stream->lookahead_ends.get(first_dirty) < edit->offset) ++first_dirty;
+
+  stream->tokens.reserve(allocator, first_dirty);
+  stream->lookahead_ends.reserve(allocator, first_dirty);
+  for (i32 i = 0; i < first_dirty; ++i) {
+    Token token    = old_stream->tokens.get(i);
+    token.text.str = new_source + (token.text.str - old_source->str);
+    push_token(allocator, stream, &token, old_stream->lookahead_ends.get(i));
+  }
+
+  i32 position = 0;
+  if (first_dirty < old_count) {
+    position = i32(old_stream->tokens.get(first_dirty).text.str - old_source->str);
+  } else if (old_count > 0) {
+    position = i32(old_stream->tokens.back().text.str - old_source->str) + old_stream->tokens.back().text.len;
+  }
+
+  Scanner scanner;
+  scanner.init(dfa, new_source + position, new_source + stream->source.len);
+  Token token;
+  i32 scanned_count = 0;
+  i32 old_index     = first_dirty;
+  while (true) {
+    // Old tokens starting past the removed range are still valid once a boundary lines up with one of them
+    if (position >= edit->offset + edit->inserted.len) {
+      while (old_index < old_count && old_stream->tokens.get(old_index).text.str - old_source->str < position - delta) {
+        ++old_index;
+      }
+      if (old_index < old_count && old_stream->tokens.get(old_index).text.str - old_source->str == position - delta) {
+        break;
+      }
+    }
+
+    if (!next_token_fn(&scanner, &token)) break;
+    push_token(allocator, stream, &token, i32(scanner.lookahead_end - new_source));
+    position = i32(scanner.current - new_source);
+    ++scanned_count;
+  }
+
+  i32 reused_count = old_count - old_index;
+  stream->tokens.reserve(allocator, stream->tokens.length + reused_count);
+  stream->lookahead_ends.reserve(allocator, stream->lookahead_ends.length + reused_count);
+  for (i32 i = old_index; i < old_count; ++i) {
+    Token reused_token    = old_stream->tokens.get(i);
+    reused_token.text.str = new_source + (reused_token.text.str - old_source->str) + delta;
+    push_token(allocator, stream, &reused_token, old_stream->lookahead_ends.get(i) + delta);
+  }
+  return scanned_count;
+}
+
+} // namespace ucl
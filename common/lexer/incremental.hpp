@@ -0,0 +1,41 @@
+#ifndef COMMON_LEXER_INCREMENTAL_HPP
+#define COMMON_LEXER_INCREMENTAL_HPP
+
+#include "common/adt/string.hpp"
+#include "common/adt/vec.hpp"
+#include "common/general.hpp"
+#include "common/lexer/scanner.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Tokens of a buffer together with how far the scanner looked ahead for each of them
+struct TokenStream {
+  void init() {
+    source = {nullptr, 0};
+    tokens.init();
+    lookahead_ends.init();
+  }
+
+  StringRef source;
+  Vec<Token> tokens;
+  Vec<i32> lookahead_ends; // Offset one past the last byte examined while scanning each token
+};
+
+// Replaces removed_length bytes at offset with the inserted text
+struct SourceEdit {
+  i32 offset;
+  i32 removed_length;
+  StringRef inserted;
+};
+
+void lex_stream(Allocator *allocator, DFA *dfa, NextTokenFn next_token_fn, StringRef source, TokenStream *stream);
+
+// Applies the edit to the source of old_stream and rescans from the first token whose scan examined the edited
+// range, until a token boundary lines up with one of the old stream again. Returns the number of tokens scanned
+i32 relex_stream(Allocator *allocator, DFA *dfa, NextTokenFn next_token_fn, TokenStream *old_stream, SourceEdit *edit,
+                 TokenStream *stream);
+
+} // namespace ucl
+
+#endif
@@ -0,0 +1,150 @@
+#include "common/lexer/lazy_dfa.hpp"
+
+namespace ucl {
+
+ArenaStats lazy_dfa_arena_stats{"lazy_dfa_states"};
+
+// Returns unknown_state instead of growing past max_states
+u32 add_lazy_state(LazyDFA *lazy_dfa, NFAStateSet *set) {
+  auto *existing_state = lazy_dfa->states.get(*set);
+  if (existing_state) return *existing_state;
+  if (lazy_dfa->state_count == lazy_dfa->max_states) return LazyDFA::unknown_state;
+
+  auto *allocator = &lazy_dfa->state_allocator;
+  NFAStateSet key;
+  key.length = set->length;
+  key.ids    = allocator->construct<i32>(set->length);
+  memory_copy(key.ids, set->ids, set->length);
+
+  // Only the dead state knows all of its transitions up front
+  u32 new_state  = lazy_dfa->state_count++;
+  u32 next_state = new_state == DFA::dead_state ? DFA::dead_state : LazyDFA::unknown_state;
+  auto *row      = &lazy_dfa->transitions[new_state * lazy_dfa->class_count];
+  for (u32 byte_class = 0; byte_class < lazy_dfa->class_count; ++byte_class) row[byte_class] = next_state;
+
+  lazy_dfa->states.insert(allocator, key, new_state);
+  lazy_dfa->state_sets[new_state]    = key;
+  lazy_dfa->accept_tokens[new_state] = accept_token_of(&lazy_dfa->nfa, &key);
+  return new_state;
+}
+
+// Drops every cached state and adds back the dead and start states
+void clear_lazy_states(LazyDFA *lazy_dfa) {
+  lazy_dfa->state_allocator.reset_to(lazy_dfa->empty_marker);
+  lazy_dfa->states.init();
+  lazy_dfa->state_count = 0;
+
+  NFAStateSet dead_set{nullptr, 0};
+  add_lazy_state(lazy_dfa, &dead_set);
+
+  i32 entry_id = lazy_dfa->fa_context.entry_node->data.id;
+  NFAStateSet entry_set{&entry_id, 1};
+  lazy_dfa->start_state = add_lazy_state(lazy_dfa, &entry_set);
+}
+
+void flush_lazy_dfa(LazyDFA *lazy_dfa) {
+  ++lazy_dfa->flush_count;
+  clear_lazy_states(lazy_dfa);
+}
+
+Result init_lazy_dfa(LazyDFA *lazy_dfa, LexerSpec *spec, u32 max_states) {
+  if (max_states < 3) {
+    error("A lazy dfa needs room for at least 3 states, got %u\n", max_states);
+    return err;
+  }
+  if (build_spec_nfa(&lazy_dfa->fa_context, spec)) return err;
+
+  // The tables are allocated once next to the nfa, a flush only releases the state sets
+  auto *allocator       = &lazy_dfa->fa_context.bump_allocator;
+  lazy_dfa->nfa         = lazy_dfa->fa_context.graph.freeze(allocator);
+  lazy_dfa->class_count = compute_byte_classes(&lazy_dfa->nfa, lazy_dfa->class_map);
+
+  // Sized in usize since max_states * class_count overflows a u32 long before the allocation fails
+  usize table_size = usize(max_states) * lazy_dfa->class_count * sizeof(u32);
+  if (table_size > LazyDFA::max_table_size) {
+    error("A lazy dfa of %u states needs %zu bytes of transitions, the limit is %zu\n", max_states, table_size,
+          LazyDFA::max_table_size);
+    lazy_dfa->fa_context.bump_allocator.destroy();
+    lazy_dfa->fa_context.scratch_allocator.destroy();
+    return err;
+  }
+
+  lazy_dfa->max_states    = max_states;
+  lazy_dfa->transitions   = allocator->construct<u32>(max_states * lazy_dfa->class_count, &dfa_table_site);
+  lazy_dfa->accept_tokens = allocator->construct<u32>(max_states, &dfa_table_site);
+  lazy_dfa->state_sets    = allocator->construct<NFAStateSet>(max_states);
+  lazy_dfa->destinations.init();
+
+  lazy_dfa->state_allocator.init(&lazy_dfa_arena_stats);
+  lazy_dfa->empty_marker = lazy_dfa->state_allocator.mark();
+  lazy_dfa->flush_count  = 0;
+  clear_lazy_states(lazy_dfa);
+  return ok;
+}
+
+void destroy_lazy_dfa(LazyDFA *lazy_dfa) {
+  lazy_dfa->state_allocator.destroy();
+  lazy_dfa->fa_context.bump_allocator.destroy();
+  lazy_dfa->fa_context.scratch_allocator.destroy();
+}
+
+u32 add_lazy_transition(LazyDFA *lazy_dfa, u32 state, u8 byte) {
+  auto *destinations = &lazy_dfa->destinations;
+  destinations->clear();
+
+  // Byte classes never split an edge, so the byte stands for its whole class
+  auto set = lazy_dfa->state_sets[state];
+  for (i32 i = 0; i < set.length; ++i) {
+    for (auto *edge : lazy_dfa->nfa.edges_of(u32(set.ids[i]))) {
+      if (byte < edge->first || byte > edge->last) continue;
+      destinations->push_back(&lazy_dfa->fa_context.scratch_allocator, i32(lazy_dfa->nfa.destination(edge)));
+    }
+  }
+  sort_unique_ids(destinations);
+
+  // destinations lives outside the state allocator, so it survives the flush of a full cache
+  NFAStateSet destination_set{destinations->data, destinations->length};
+  u32 next_state = add_lazy_state(lazy_dfa, &destination_set);
+  if (next_state == LazyDFA::unknown_state) {
+    flush_lazy_dfa(lazy_dfa);
+    return add_lazy_state(lazy_dfa, &destination_set);
+  }
+
+  lazy_dfa->transitions[state * lazy_dfa->class_count + lazy_dfa->class_map[byte]] = next_state;
+  return next_state;
+}
+
+bool lazy_next_token(LazyDFA *lazy_dfa, Scanner *scanner, Token *token) {
+  cstr start = scanner->current;
+  if (start == scanner->end) return false;
+
+  // The tables never move, a flush only rewrites them
+  auto *transitions   = lazy_dfa->transitions;
+  auto *accept_tokens = lazy_dfa->accept_tokens;
+  auto *class_map     = lazy_dfa->class_map;
+  u32 class_count     = lazy_dfa->class_count;
+
+  u32 state        = lazy_dfa->start_state;
+  u32 accept_token = FANode::no_accept;
+  cstr accept_end  = start + 1;
+  cstr current     = start;
+  while (current != scanner->end) {
+    u8 byte  = u8(*current++);
+    u32 next = transitions[state * class_count + class_map[byte]];
+    state    = next != LazyDFA::unknown_state ? next : add_lazy_transition(lazy_dfa, state, byte);
+    if (state == DFA::dead_state) break;
+    if (accept_tokens[state] != FANode::no_accept) {
+      accept_token = accept_tokens[state];
+      accept_end   = current;
+    }
+  }
+
+  token->accept_token    = accept_token;
+  token->text.str        = start;
+  token->text.len        = i32(accept_end - start);
+  scanner->current       = accept_end;
+  scanner->lookahead_end = current;
+  return true;
+}
+
+} // namespace ucl
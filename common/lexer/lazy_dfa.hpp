@@ -0,0 +1,57 @@
+#ifndef COMMON_LEXER_LAZY_DFA_HPP
+#define COMMON_LEXER_LAZY_DFA_HPP
+
+#include "common/adt/map.hpp"
+#include "common/adt/vec.hpp"
+#include "common/general.hpp"
+#include "common/lexer/dfa.hpp"
+#include "common/lexer/lexer.hpp"
+#include "common/lexer/scanner.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Subset construction run while scanning. A dfa state is only built the first time the input reaches it, and at
+// most max_states are cached. A full cache is flushed and refilled, so memory stays bounded for any token set while
+// input which keeps to the cached states runs over plain transition tables
+struct LazyDFA {
+  static const u32 unknown_state   = u32(-1);         // Transition not built yet
+  static const usize max_table_size = usize(1) << 30; // Bytes, also keeps every table index within a u32
+
+  FAContext fa_context;
+  FrozenGraph<FANode, FAEdge> nfa; // Reduced nfa of the spec
+  u32 start_state;
+
+  u32 class_count;
+  u8 class_map[DFA::alphabet_size];
+
+  // Sized for max_states when the automaton is created and reused after every flush
+  u32 max_states;
+  u32 state_count;
+  u32 *transitions; // Indexed by state * class_count + class
+  u32 *accept_tokens;
+  NFAStateSet *state_sets;
+
+  BumpAllocator state_allocator; // Keys and table of states, released by a flush
+  BumpMarker empty_marker;
+  SwissMap<NFAStateSet, u32> states;
+
+  Vec<i32> destinations; // Node ids of the transition being built
+  i32 flush_count;
+};
+
+// Fails when the spec does not compile, max_states cannot hold the dead state, the start state and one more, or the
+// transition table of max_states would pass max_table_size
+Result init_lazy_dfa(LazyDFA *lazy_dfa, LexerSpec *spec, u32 max_states);
+
+void destroy_lazy_dfa(LazyDFA *lazy_dfa);
+
+// Builds the transition of state on byte. This may flush the cache, after which only the returned state is valid
+u32 add_lazy_transition(LazyDFA *lazy_dfa, u32 state, u8 byte);
+
+// Same contract as next_token, scanner->dfa is not used
+bool lazy_next_token(LazyDFA *lazy_dfa, Scanner *scanner, Token *token);
+
+} // namespace ucl
+
+#endif
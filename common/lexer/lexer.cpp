@@ -1,10 +1,26 @@
 #include "common/lexer/lexer.hpp"
 
+#include "common/adt/hash.hpp"
+#include "common/lexer/dfa.hpp"
+#include "common/lexer/dfa_file.hpp"
 #include "common/lexer/nfa.hpp"
 #include "common/lexer/regex.hpp"
 
 namespace ucl {
 
+ArenaStats nfa_arena_stats{"nfa"};
+ArenaStats lexer_scratch_arena_stats{"lexer_scratch"};
+
+void dump_symbol(FILE *out, u8 symbol) {
+  if (symbol == '"' || symbol == '\\') {
+    fprintf(out, "\\\\%c", symbol);
+  } else if (symbol > ' ' && symbol < 127) {
+    fprintf(out, "%c", symbol);
+  } else {
+    fprintf(out, "\\\\x%02x", symbol);
+  }
+}
+
 void dump_graph(FILE *out, FAContext *fa_context) {
   fprintf(out, "digraph G {\n");
   for (auto *node : fa_context->graph) {
@@ -19,15 +35,21 @@ void dump_graph(FILE *out, FAContext *fa_context) {
       }
     }
     if (node->data.accept_token != FANode::no_accept) {
-      fprintf(out, ",label=\"n%d\\n%d\"", node->data.id, node->data.accept_token);
+      fprintf(out, ",label=\"n%d\\n%u\"", node->data.id, node->data.accept_token);
     } else {
       fprintf(out, "");
     }
     fprintf(out, "]\n");
     for (auto *fa_edge : node->edges) {
       fprintf(out, "  n%d->n%d", node->data.id, fa_edge->dest->data.id);
-      if (fa_edge->symbol) {
-        fprintf(out, "[label=\"%c\"]", fa_edge->symbol);
+      if (!fa_edge->is_epsilon()) {
+        fprintf(out, "[label=\"");
+        dump_symbol(out, fa_edge->first);
+        if (fa_edge->last != fa_edge->first) {
+          fprintf(out, "-");
+          dump_symbol(out, fa_edge->last);
+        }
+        fprintf(out, "\"]");
       } else {
         fprintf(out, "[style=dotted]");
       }
@@ -37,27 +59,79 @@ void dump_graph(FILE *out, FAContext *fa_context) {
   fprintf(out, "}\n");
 }
 
-Result generate_lexer() {
+Result build_spec_nfa(FAContext *fa_context, LexerSpec *spec) {
+  fa_context->bump_allocator.init(&nfa_arena_stats);
+  fa_context->scratch_allocator.init(&lexer_scratch_arena_stats);
+  fa_context->graph.init();
+
+  fa_context->entry_node = fa_context->graph.nodes.get(add_node(fa_context));
+
+  // Every rule hangs off the shared entry node so all tokens are scanned by one automaton
+  for (i32 i = 0; i < spec->rule_count; ++i) {
+    auto *rule             = &spec->rules[i];
+    auto *regex_entry_node = generate_nfa(fa_context, rule->token, rule->priority, strref(rule->regex));
+    if (!regex_entry_node) {
+      error("Failed to generate nfa for token %u\n", rule->token);
+      fa_context->bump_allocator.destroy();
+      fa_context->scratch_allocator.destroy();
+      return err;
+    }
+    auto *edge = fa_context->graph.link(&fa_context->bump_allocator, fa_context->entry_node, regex_entry_node);
+    edge->set_epsilon();
+  }
+
+  reduce_nfa(fa_context);
+  return ok;
+}
+
+Result generate_lexer(Allocator *allocator, DFA *dfa, LexerSpec *spec, FILE *dump_out) {
   FAContext fa_context;
-  fa_context.bump_allocator.init();
-  fa_context.graph.init();
-  fa_context.visited.init();
+  if (build_spec_nfa(&fa_context, spec)) return err;
 
-  fa_context.entry_node = fa_context.graph.nodes.get(add_node(&fa_context));
+  if (dump_out) dump_graph(dump_out, &fa_context);
 
-  // TODO: get the correct accept_token value
-  auto *regex_entry_node = generate_nfa(&fa_context, 555, strref("(ab|c)*"));
-  if (!regex_entry_node) {
-    error("Failed to generate nfa\n");
+  if (determinize_nfa(&fa_context, allocator, dfa)) {
+    error("Failed to generate dfa\n");
+    fa_context.bump_allocator.destroy();
+    fa_context.scratch_allocator.destroy();
     return err;
   }
-  auto *edge   = fa_context.graph.link(&fa_context.bump_allocator, fa_context.entry_node, regex_entry_node);
-  edge->symbol = FAEdge::epsilon;
 
-  reduce_nfa(&fa_context);
+  // The nfa is no longer needed once the dfa exists
+  fa_context.bump_allocator.destroy();
 
-  dump_graph(stdout, &fa_context);
+  u32 unminimized_state_count = dfa->state_count;
+  minimize_dfa(&fa_context.scratch_allocator, dfa);
+  fa_context.scratch_allocator.destroy();
+  if (dump_out) {
+    fprintf(dump_out, "DFA states: %u before minimization, %u after\n", unminimized_state_count, dfa->state_count);
+    fprintf(dump_out, "DFA byte classes: %u (%u table bytes)\n", dfa->class_count,
+            u32(sizeof(u32)) * dfa->state_count * dfa->class_count);
+    dump_dfa(dump_out, dfa);
+  }
+  return ok;
+}
+
+Result load_lexer(Allocator *allocator, DFA *dfa, LexerSpec *spec, cstr cache_dir, MappedDFA *mapped_dfa) {
+  u32 versions[2] = {DFAFileHeader::version_value, lexer_generator_version};
+  u64 spec_hash   = hash_memory(versions, sizeof(versions));
+  for (i32 i = 0; i < spec->rule_count; ++i) {
+    auto *rule = &spec->rules[i];
+    spec_hash  = hash_memory(&rule->token, sizeof(u32), spec_hash);
+    spec_hash  = hash_memory(&rule->priority, sizeof(u32), spec_hash);
+    spec_hash  = hash_memory(rule->regex, strlen(rule->regex), spec_hash);
+  }
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/lexer-%016lx.dfa", cache_dir, spec_hash);
+  if (!map_dfa_file(path, spec_hash, dfa, mapped_dfa)) return ok;
+
+  mapped_dfa->mapping = nullptr;
+  mapped_dfa->length  = 0;
+  if (generate_lexer(allocator, dfa, spec, nullptr)) return err;
 
+  // A cache which cannot be written only costs the next run a rebuild
+  if (write_dfa_file(path, dfa, spec_hash)) error("Could not cache lexer tables in '%s'\n", cache_dir);
   return ok;
 }
 
@@ -67,17 +141,25 @@ FANodeId add_node(FAContext *fa_context) {
   FANode fa_node;
   fa_node.id              = fa_node_id;
   fa_node.accept_token    = FANode::no_accept;
-  fa_node.visited         = false;
+  fa_node.accept_priority = FANode::no_accept;
   fa_node.reference_count = 0;
   fa_context->graph.add_node(&fa_context->bump_allocator, fa_node);
   return fa_node_id;
 }
 
-void add_transition(FAContext *fa_context, FANodeId source_id, char symbol, FANodeId destination_id) {
+void add_transition(FAContext *fa_context, FANodeId source_id, u8 first, u8 last, FANodeId destination_id) {
+  auto *source_node      = fa_context->graph.nodes.get(i32(source_id));
+  auto *destination_node = fa_context->graph.nodes.get(i32(destination_id));
+  auto *edge             = fa_context->graph.link(&fa_context->bump_allocator, source_node, destination_node);
+  edge->set_range(first, last);
+  ++destination_node->data.reference_count;
+}
+
+void add_epsilon_transition(FAContext *fa_context, FANodeId source_id, FANodeId destination_id) {
   auto *source_node      = fa_context->graph.nodes.get(i32(source_id));
   auto *destination_node = fa_context->graph.nodes.get(i32(destination_id));
   auto *edge             = fa_context->graph.link(&fa_context->bump_allocator, source_node, destination_node);
-  edge->symbol           = symbol;
+  edge->set_epsilon();
   ++destination_node->data.reference_count;
 }
 
@@ -2,6 +2,7 @@
 #define COMMON_LEXER_LEXER_HPP
 
 #include "common/adt/graph.hpp"
+#include "common/adt/small_vec.hpp"
 #include "common/general.hpp"
 #include "common/mem.hpp"
 
@@ -15,34 +16,89 @@ struct FANodeId : Encapsulate<i32> {
 struct FANode {
   static const u32 no_accept = u32(-1);
 
+  // When several tokens accept at the same node the lowest priority wins, ties go to the lowest token
+  bool accepts_before(FANode *other) {
+    if (accept_priority != other->accept_priority) return accept_priority < other->accept_priority;
+    return accept_token < other->accept_token;
+  }
+
   i32 id;
   u32 accept_token;
-  bool visited;
+  u32 accept_priority;
 
   i32 reference_count;
 };
 
+struct FAEdge;
+
+// Thompson construction leaves at most two edges on a node, only epsilon reduction spills to the allocator
+using FAEdgeList  = SmallVec<FAEdge, 2>;
+using FAGraphNode = Node<FANode, FAEdge, FAEdgeList>;
+
+// Matches any byte in [first, last], an empty range is an epsilon edge
 struct FAEdge {
-  static const char epsilon = 0;
+  bool is_epsilon() { return first > last; }
+
+  void set_epsilon() {
+    first = 1;
+    last  = 0;
+  }
 
-  char symbol;
-  Node<FANode, FAEdge> *dest;
+  void set_range(u8 range_first, u8 range_last) {
+    first = range_first;
+    last  = range_last;
+  }
+
+  u8 first;
+  u8 last;
+  FAGraphNode *dest;
 };
 
 struct FAContext {
   BumpAllocator bump_allocator;
+  BumpAllocator scratch_allocator; // Temporaries of a single pass, released through mark() and reset_to()
+
+  Graph<FANode, FAEdge, FAEdgeList> graph;
+  FAGraphNode *entry_node;
+};
 
-  Graph<FANode, FAEdge> graph;
-  Node<FANode, FAEdge> *entry_node;
+struct TokenRule {
+  u32 token;
+  cstr regex;
+  u32 priority; // Breaks ties between rules matching the same longest lexeme, lower wins
+};
 
-  Vec<Node<FANode, FAEdge> *> visited;
+// Token specification compiled into a single automaton
+struct LexerSpec {
+  TokenRule *rules;
+  i32 rule_count;
 };
 
-Result generate_lexer();
+struct DFA;
+struct MappedDFA;
+
+// Builds the epsilon free nfa of every rule behind one entry node. On success the caller owns both allocators
+Result build_spec_nfa(FAContext *fa_context, LexerSpec *spec);
+
+// Intermediate automata and statistics are written to dump_out unless it is null
+Result generate_lexer(Allocator *allocator, DFA *dfa, LexerSpec *spec, FILE *dump_out);
+
+// Part of the lexer cache key. Bump it whenever the regex dialect or the nfa and dfa construction change the tables
+// generated for an unchanged spec, so tables cached by an older generator are never mapped
+const u32 lexer_generator_version = 2;
+
+// Maps the tables cached in cache_dir for the token specification, or generates and caches them.
+// mapped_dfa->mapping is null when the tables were generated into the allocator instead
+Result load_lexer(Allocator *allocator, DFA *dfa, LexerSpec *spec, cstr cache_dir, MappedDFA *mapped_dfa);
 
 FANodeId add_node(FAContext *fa_context);
 
-void add_transition(FAContext *fa_context, FANodeId source_id, char symbol, FANodeId destination_id);
+void add_transition(FAContext *fa_context, FANodeId source_id, u8 first, u8 last, FANodeId destination_id);
+
+void add_epsilon_transition(FAContext *fa_context, FANodeId source_id, FANodeId destination_id);
+
+// Writes a byte escaped for a dot label
+void dump_symbol(FILE *out, u8 symbol);
 
 } // namespace ucl
 
@@ -0,0 +1,56 @@
+#include "common/lexer/line_filter.hpp"
+
+#include "common/lexer/regex.hpp"
+
+namespace ucl {
+
+bool lazy_dfa_search(LazyDFA *lazy_dfa, cstr begin, cstr end) {
+  u32 state = lazy_dfa->start_state;
+  if (lazy_dfa->accept_tokens[state] != FANode::no_accept) return true;
+  for (cstr current = begin; current != end; ++current) {
+    u8 byte  = u8(*current);
+    u32 next = lazy_dfa->transitions[state * lazy_dfa->class_count + lazy_dfa->class_map[byte]];
+    state    = next != LazyDFA::unknown_state ? next : add_lazy_transition(lazy_dfa, state, byte);
+    if (state == DFA::dead_state) return false;
+    if (lazy_dfa->accept_tokens[state] != FANode::no_accept) return true;
+  }
+  return false;
+}
+
+Result init_line_filter(Allocator *allocator, LineFilter *filter, StringRef regex) {
+  // Parsed once up front so a regex too large for Shift-And falls back quietly and a broken one fails once
+  {
+    BumpScope parse_scope(allocator);
+    auto *root = parse_regex(allocator, regex);
+    if (!root) return err;
+    filter->uses_shift_and = count_sets(root) <= ShiftAndMatcher::max_positions;
+  }
+  if (filter->uses_shift_and && compile_shift_and(allocator, &filter->shift_and, regex)) return err;
+
+  filter->has_dfa = !filter->uses_shift_and || DEBUG;
+  if (!filter->has_dfa) return ok;
+
+  auto *search_regex = allocator->construct<char>(regex.len + 6);
+  snprintf(search_regex, usize(regex.len + 6), ".*(%.*s)", regex.len, regex.str);
+  TokenRule rule{0, search_regex, 0};
+  LexerSpec spec{&rule, 1};
+  return init_lazy_dfa(&filter->lazy_dfa, &spec, LineFilter::dfa_states);
+}
+
+void destroy_line_filter(LineFilter *filter) {
+  if (filter->has_dfa) destroy_lazy_dfa(&filter->lazy_dfa);
+}
+
+bool line_matches(LineFilter *filter, cstr begin, cstr end) {
+  if (!filter->uses_shift_and) return lazy_dfa_search(&filter->lazy_dfa, begin, end);
+
+  bool matches = shift_and_search(&filter->shift_and, begin, end) >= 0;
+#if DEBUG
+  if (matches != lazy_dfa_search(&filter->lazy_dfa, begin, end)) {
+    panic("Shift-And and dfa disagree on line '%.*s'\n", i32(end - begin), begin);
+  }
+#endif
+  return matches;
+}
+
+} // namespace ucl
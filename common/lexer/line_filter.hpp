@@ -0,0 +1,33 @@
+#ifndef COMMON_LEXER_LINE_FILTER_HPP
+#define COMMON_LEXER_LINE_FILTER_HPP
+
+#include "common/adt/string.hpp"
+#include "common/general.hpp"
+#include "common/lexer/lazy_dfa.hpp"
+#include "common/lexer/shift_and.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Selects lines containing a match of an ad hoc regex, such as the error lines of a build log. Regexes of up to
+// ShiftAndMatcher::max_positions sets run on the Shift-And matcher, larger ones on a lazy dfa of bounded size.
+// Debug builds run both and panic when they disagree
+struct LineFilter {
+  static const u32 dfa_states = 4096;
+
+  ShiftAndMatcher shift_and;
+  LazyDFA lazy_dfa; // Scans for .*(regex), so reaching any accepting state is a match
+  bool uses_shift_and;
+  bool has_dfa;
+};
+
+Result init_line_filter(Allocator *allocator, LineFilter *filter, StringRef regex);
+
+void destroy_line_filter(LineFilter *filter);
+
+// The line excludes its newline
+bool line_matches(LineFilter *filter, cstr begin, cstr end);
+
+} // namespace ucl
+
+#endif
@@ -1,74 +1,149 @@
 #include "common/lexer/nfa.hpp"
 
-namespace ucl {
+#include "common/adt/graph_algorithms.hpp"
 
-void gather_transitions(FAContext *fa_context, Node<FANode, FAEdge> *source, Node<FANode, FAEdge> *current_dfs) {
-  current_dfs->data.visited = true;
-  fa_context->visited.push_back(&fa_context->bump_allocator, current_dfs);
+namespace ucl {
 
-  if (current_dfs->data.accept_token < source->data.accept_token) {
-    source->data.accept_token = current_dfs->data.accept_token;
-  }
+// Byte edge packed so sorting groups edges by destination, then by range
+u64 pack_closure_edge(i32 destination_id, u8 first, u8 last) {
+  return u64(u32(destination_id)) << 16U | u64(first) << 8U | last;
+}
 
-  for (auto *edge : current_dfs->edges) {
-    if (edge->symbol == FAEdge::epsilon) {
-      if (!edge->dest->data.visited) gather_transitions(fa_context, source, edge->dest);
-    } else if (source != current_dfs) {
-      auto *new_edge   = fa_context->graph.link(&fa_context->bump_allocator, source, edge->dest);
-      new_edge->symbol = edge->symbol;
-      ++edge->dest->data.reference_count;
-    }
-  }
+i32 compare_packed_edges(const void *edge1, const void *edge2) {
+  u64 packed1 = *(const u64 *)edge1;
+  u64 packed2 = *(const u64 *)edge2;
+  return i32(packed1 > packed2) - i32(packed1 < packed2);
 }
 
-void cleanup_zero_reference_nodes(Node<FANode, FAEdge> *node) {
-  if (node->data.reference_count > 0) return;
-  for (auto *edge : node->edges) {
-    --edge->dest->data.reference_count;
-    cleanup_zero_reference_nodes(edge->dest);
+// Everything a node reaches through epsilon edges, shared by the nodes of one epsilon cycle
+struct EpsilonClosure {
+  u64 *edges; // Sorted and unique packed byte edges of every node in the closure
+  i32 edge_count;
+  FANode accept; // Node of the closure which accepts first
+};
+
+// Epsilon edges only, node ids are indices into the graph
+GraphView epsilon_graph(FAContext *fa_context) {
+  auto *allocator = &fa_context->scratch_allocator;
+  auto *nodes     = &fa_context->graph.nodes;
+
+  u32 edge_count = 0;
+  for (auto *node : fa_context->graph) {
+    for (auto *edge : node->edges) edge_count += u32(edge->is_epsilon());
   }
-}
 
-void delete_episilon_transitions(Node<FANode, FAEdge> *node) {
-  for (i32 i = 0; i < node->edges.length; ++i) {
-    if (node->edges.get_reference(i)->symbol == FAEdge::epsilon) {
-      --node->edges.get_reference(i)->dest->data.reference_count;
-      cleanup_zero_reference_nodes(node->edges.get_reference(i)->dest);
+  GraphView graph_view;
+  graph_view.node_count        = u32(nodes->length);
+  graph_view.edge_offsets      = allocator->construct<u32>(nodes->length + 1);
+  graph_view.edge_destinations = allocator->construct<u32>(edge_count);
 
-      node->edges.data[i] = node->edges.back();
-      node->edges.pop_back();
+  u32 edge_offset = 0;
+  for (i32 i = 0; i < nodes->length; ++i) {
+    graph_view.edge_offsets[i] = edge_offset;
+    for (auto *edge : nodes->get(i)->edges) {
+      if (edge->is_epsilon()) graph_view.edge_destinations[edge_offset++] = u32(edge->dest->data.id);
     }
   }
+  graph_view.edge_offsets[nodes->length] = edge_offset;
+  return graph_view;
 }
 
+// Replaces the edges of every node by the byte edges of its epsilon closure. Closures are computed once per epsilon
+// strongly connected component, in reverse topological order so a component only merges finished closures
 void reduce_nfa(FAContext *fa_context) {
-  auto post_ordering = fa_context->graph.post_order(&fa_context->bump_allocator);
+  auto *allocator = &fa_context->scratch_allocator;
+  auto *nodes     = &fa_context->graph.nodes;
+  BumpScope reduce_scope(allocator);
 
-  for (auto *node : post_ordering) {
-    for (auto *visited_node : fa_context->visited) {
-      (*visited_node)->data.visited = false;
-    }
-    fa_context->visited.clear();
+  auto epsilon_edges = epsilon_graph(fa_context);
+  auto components    = strongly_connected_components(allocator, epsilon_edges);
 
-    gather_transitions(fa_context, node, node);
-    delete_episilon_transitions(node);
+  // Nodes grouped by component with a counting sort
+  auto *member_offsets = allocator->construct<u32>(components.component_count + 1);
+  auto *fill_offsets   = allocator->construct<u32>(components.component_count);
+  auto *members        = allocator->construct<u32>(nodes->length);
+  memory_clear(member_offsets, i32(components.component_count + 1));
+  for (i32 id = 0; id < nodes->length; ++id) ++member_offsets[components.component_of[id] + 1];
+  for (u32 component = 0; component < components.component_count; ++component) {
+    member_offsets[component + 1] += member_offsets[component];
   }
+  memory_copy(fill_offsets, member_offsets, i32(components.component_count));
+  for (i32 id = 0; id < nodes->length; ++id) members[fill_offsets[components.component_of[id]]++] = u32(id);
 
-  for (i32 i = 0; i < fa_context->graph.nodes.length; ++i) {
-    fa_context->graph.nodes.get(i)->data.id = i;
+  FANode no_accept_node{};
+  no_accept_node.accept_token    = FANode::no_accept;
+  no_accept_node.accept_priority = FANode::no_accept;
+
+  // merged_into keeps a component from merging the same successor closure twice
+  auto *closures    = allocator->construct<EpsilonClosure>(components.component_count);
+  auto *merged_into = allocator->construct<u32>(components.component_count);
+  for (u32 component = 0; component < components.component_count; ++component) merged_into[component] = no_node;
+
+  Vec<u64> merged_edges;
+  merged_edges.init();
+  for (u32 component = 0; component < components.component_count; ++component) {
+    auto *closure   = &closures[component];
+    closure->accept = no_accept_node;
+    merged_edges.clear();
+
+    for (u32 k = member_offsets[component]; k < member_offsets[component + 1]; ++k) {
+      auto *member = nodes->get(i32(members[k]));
+      if (member->data.accepts_before(&closure->accept)) closure->accept = member->data;
+
+      for (auto *edge : member->edges) {
+        if (!edge->is_epsilon()) {
+          merged_edges.push_back(allocator, pack_closure_edge(edge->dest->data.id, edge->first, edge->last));
+          continue;
+        }
+
+        u32 successor = components.component_of[edge->dest->data.id];
+        if (successor == component || merged_into[successor] == component) continue;
+        merged_into[successor] = component;
+
+        auto *successor_closure = &closures[successor];
+        if (successor_closure->accept.accepts_before(&closure->accept)) closure->accept = successor_closure->accept;
+        merged_edges.reserve(allocator, merged_edges.length + successor_closure->edge_count);
+        memory_copy(&merged_edges.data[merged_edges.length], successor_closure->edges, successor_closure->edge_count);
+        merged_edges.length += successor_closure->edge_count;
+      }
+    }
+
+    // A byte edge reached along several epsilon paths is kept once
+    i32 unique_length = 0;
+    if (merged_edges.length) {
+      qsort(merged_edges.data, usize(merged_edges.length), sizeof(u64), compare_packed_edges);
+      unique_length = 1;
+      for (i32 i = 1; i < merged_edges.length; ++i) {
+        if (merged_edges.data[i] != merged_edges.data[unique_length - 1]) {
+          merged_edges.data[unique_length++] = merged_edges.data[i];
+        }
+      }
+    }
+    closure->edge_count = unique_length;
+    closure->edges      = allocator->construct<u64>(unique_length);
+    memory_copy(closure->edges, merged_edges.data, unique_length);
   }
 
-  /*
-  for (auto *node : post_ordering) {
-    if (node == fa_context->entry_node) continue;
+  for (auto *node : fa_context->graph) node->data.reference_count = 0;
+  for (i32 id = 0; id < nodes->length; ++id) {
+    auto *node    = nodes->get(id);
+    auto *closure = &closures[components.component_of[id]];
 
-    if (node->data.reference_count == 0) {
-      fa_context->graph.nodes.back()->data.id     = node->data.id;
-      fa_context->graph.nodes.data[node->data.id] = fa_context->graph.nodes.back();
-      fa_context->graph.nodes.pop_back();
+    node->data.accept_token    = closure->accept.accept_token;
+    node->data.accept_priority = closure->accept.accept_priority;
+    node->edges.clear();
+    for (i32 i = 0; i < closure->edge_count; ++i) {
+      u64 packed     = closure->edges[i];
+      auto *dest     = nodes->get(i32(packed >> 16U));
+      auto *new_edge = fa_context->graph.link(&fa_context->bump_allocator, node, dest);
+      new_edge->set_range(u8(packed >> 8U), u8(packed));
+      ++dest->data.reference_count;
     }
   }
-  */
+
+  for (i32 i = 0; i < fa_context->graph.nodes.length; ++i) {
+    fa_context->graph.nodes.get(i)->data.id = i;
+  }
 }
 
 } // namespace ucl
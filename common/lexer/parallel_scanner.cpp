@@ -0,0 +1,104 @@
+#include "common/lexer/parallel_scanner.hpp"
+
+#include <pthread.h>
+
+namespace ucl {
+
+// Chunks smaller than this are not worth a thread
+const i64 min_chunk_length = 64 * 1024;
+
+struct ScanChunk {
+  DFA *dfa;
+  NextTokenFn next_token_fn;
+
+  cstr begin;      // Speculative tokens start in [begin, end)
+  cstr end;
+  cstr source_end; // Tokens may extend past the chunk up to the end of the source
+
+  BumpAllocator *allocator; // Taken from the pool, the scanning thread is its only user
+  Vec<Token> tokens;
+};
+
+void *scan_chunk(void *argument) {
+  auto *chunk = (ScanChunk *)argument;
+
+  Scanner scanner;
+  scanner.init(chunk->dfa, chunk->begin, chunk->source_end);
+  Token token;
+  while (scanner.current < chunk->end && chunk->next_token_fn(&scanner, &token)) {
+    chunk->tokens.push_back(chunk->allocator, token);
+  }
+  return nullptr;
+}
+
+void scan_parallel(Allocator *allocator, ArenaPool *arena_pool, DFA *dfa, NextTokenFn next_token_fn, cstr begin,
+                   cstr end, i32 thread_count, Vec<Token> *tokens) {
+  i64 length      = end - begin;
+  i64 chunk_count = thread_count;
+  if (chunk_count > length / min_chunk_length) chunk_count = length / min_chunk_length;
+  if (chunk_count < 1) chunk_count = 1;
+
+  // Bookkeeping which does not outlive the call
+  BumpScope scan_scope(thread_arena());
+
+  auto *chunks = thread_arena()->construct<ScanChunk>(chunk_count);
+  for (i64 i = 0; i < chunk_count; ++i) {
+    auto *chunk          = &chunks[i];
+    chunk->dfa           = dfa;
+    chunk->next_token_fn = next_token_fn;
+    chunk->begin         = begin + length * i / chunk_count;
+    chunk->end           = begin + length * (i + 1) / chunk_count;
+    chunk->source_end    = end;
+    chunk->allocator     = arena_pool->acquire();
+    chunk->tokens.init();
+  }
+
+  // The first chunk is scanned on the calling thread
+  auto *threads = thread_arena()->construct<pthread_t>(chunk_count);
+  for (i64 i = 1; i < chunk_count; ++i) {
+    if (pthread_create(&threads[i], nullptr, scan_chunk, &chunks[i])) panic("Failed to create scanner thread\n");
+  }
+  scan_chunk(&chunks[0]);
+  for (i64 i = 1; i < chunk_count; ++i) pthread_join(threads[i], nullptr);
+
+  Scanner scanner;
+  scanner.init(dfa, begin, end);
+  Token token;
+
+  // position is always a true token boundary
+  cstr position = begin;
+  for (i64 i = 0; i < chunk_count; ++i) {
+    auto *speculative = &chunks[i].tokens;
+    i32 index         = 0;
+    while (true) {
+      while (index < speculative->length && speculative->data[index].text.str < position) ++index;
+
+      if (index == speculative->length) {
+        // Speculation never converged, the rest of the chunk is scanned directly
+        scanner.current = position;
+        while (scanner.current < chunks[i].end && next_token_fn(&scanner, &token)) tokens->push_back(allocator, token);
+        position = scanner.current;
+        break;
+      }
+
+      if (speculative->data[index].text.str == position) {
+        // Both streams share a boundary so every following speculative token is exact
+        i32 count = speculative->length - index;
+        tokens->reserve(allocator, tokens->length + count);
+        memory_copy(&tokens->data[tokens->length], &speculative->data[index], count);
+        tokens->length += count;
+        position = tokens->back().text.str + tokens->back().text.len;
+        break;
+      }
+
+      scanner.current = position;
+      next_token_fn(&scanner, &token);
+      tokens->push_back(allocator, token);
+      position = scanner.current;
+    }
+  }
+
+  for (i64 i = 0; i < chunk_count; ++i) arena_pool->release(chunks[i].allocator);
+}
+
+} // namespace ucl
@@ -0,0 +1,20 @@
+#ifndef COMMON_LEXER_PARALLEL_SCANNER_HPP
+#define COMMON_LEXER_PARALLEL_SCANNER_HPP
+
+#include "common/adt/vec.hpp"
+#include "common/general.hpp"
+#include "common/lexer/scanner.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Splits the buffer into chunks which are scanned speculatively on separate threads, each assuming a token
+// starts at its first byte. Chunks are then stitched in order: wherever the true token boundary does not line up
+// with a speculative one the stitcher rescans until the two streams converge. The result matches a sequential scan.
+// Speculative tokens live in arenas taken from arena_pool for the duration of the call
+void scan_parallel(Allocator *allocator, ArenaPool *arena_pool, DFA *dfa, NextTokenFn next_token_fn, cstr begin,
+                   cstr end, i32 thread_count, Vec<Token> *tokens);
+
+} // namespace ucl
+
+#endif
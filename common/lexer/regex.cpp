@@ -8,7 +8,8 @@ struct RegexParser {
   i32 index;
   StringRef regex;
 
-  FAContext *fa_context;
+  Allocator *allocator;
+  i32 set_count;
 };
 
 bool is_end(RegexParser *regex_parser) { return regex_parser->index == regex_parser->regex.len; }
@@ -29,108 +30,417 @@ void error_with_info(RegexParser *regex_parser, cstr msg) {
   error("in regex at %d in '%s': %s\n", regex_parser->index, regex, msg);
 }
 
-struct NFAComponent {
-  FANodeId entry_id;
-  FANodeId exit_id;
-};
+RegexNode *make_node(RegexParser *regex_parser, RegexNode::Kind kind, RegexNode *left, RegexNode *right) {
+  auto *node        = regex_parser->allocator->construct<RegexNode>();
+  node->kind        = kind;
+  node->ranges      = nullptr;
+  node->range_count = 0;
+  node->left        = left;
+  node->right       = right;
+  return node;
+}
 
-Result parse_infix(RegexParser *regex_parser, NFAComponent *lvalue, i32 min_precedence) {
+// Turns a byte membership table into a set of ranges
+RegexNode *make_set(RegexParser *regex_parser, bool *members) {
+  i32 range_count = 0;
+  for (u32 byte = 0; byte < 256; ++byte) {
+    if (members[byte] && (byte == 0 || !members[byte - 1])) ++range_count;
+  }
+  if (range_count == 0) {
+    error_with_info(regex_parser, "Character class matches nothing");
+    return nullptr;
+  }
+
+  auto *node        = make_node(regex_parser, RegexNode::set, nullptr, nullptr);
+  node->ranges      = regex_parser->allocator->construct<RegexRange>(range_count);
+  node->range_count = 0;
+  for (u32 byte = 0; byte < 256; ++byte) {
+    if (!members[byte]) continue;
+    if (byte == 0 || !members[byte - 1]) node->ranges[node->range_count++].first = u8(byte);
+    node->ranges[node->range_count - 1].last = u8(byte);
+  }
+  ++regex_parser->set_count;
+  return node;
+}
+
+void add_members(bool *members, u32 first, u32 last) {
+  for (u32 byte = first; byte <= last; ++byte) members[byte] = true;
+}
+
+i32 hex_digit(char digit) {
+  if (digit >= '0' && digit <= '9') return digit - '0';
+  if (digit >= 'a' && digit <= 'f') return digit - 'a' + 10;
+  if (digit >= 'A' && digit <= 'F') return digit - 'A' + 10;
+  return -1;
+}
+
+// Parses the escape following a backslash. Single byte escapes are also returned in byte so they can start a range
+Result parse_escape(RegexParser *regex_parser, bool *members, i32 *byte) {
   if (is_end(regex_parser)) {
-    error_with_info(regex_parser, "Expected more characters");
+    error_with_info(regex_parser, "Expected character after \\");
     return err;
-  };
-
-  switch (peek(regex_parser)) {
-  case '|':
-  case '*': error_with_info(regex_parser, "Expected character instead of operator"); return err;
-  case '(':
-    next(regex_parser);
+  }
 
-    parse_infix(regex_parser, lvalue, 0);
+  char escaped = peek(regex_parser);
+  next(regex_parser);
 
-    if (peek(regex_parser) != ')') error_with_info(regex_parser, "Expected ) to match previous (");
+  *byte = -1;
+  switch (escaped) {
+  case 'd': add_members(members, '0', '9'); return ok;
+  case 'w':
+    add_members(members, '0', '9');
+    add_members(members, 'a', 'z');
+    add_members(members, 'A', 'Z');
+    members['_'] = true;
+    return ok;
+  case 's':
+    add_members(members, '\t', '\r');
+    members[' '] = true;
+    return ok;
+  case 'n': *byte = '\n'; break;
+  case 't': *byte = '\t'; break;
+  case 'r': *byte = '\r'; break;
+  case 'f': *byte = '\f'; break;
+  case 'v': *byte = '\v'; break;
+  case '0': *byte = '\0'; break;
+  case 'x': {
+    i32 high = is_end(regex_parser) ? -1 : hex_digit(peek(regex_parser));
+    if (high >= 0) next(regex_parser);
+    i32 low = is_end(regex_parser) ? -1 : hex_digit(peek(regex_parser));
+    if (high < 0 || low < 0) {
+      error_with_info(regex_parser, "Expected two hex digits after \\x");
+      return err;
+    }
     next(regex_parser);
+    *byte = high * 16 + low;
     break;
-  case ')': error_with_info(regex_parser, "Unexpected )"); break;
+  }
   default:
-    if ((u8)peek(regex_parser) >= 128) {
-      error_with_info(regex_parser, "ASCII value >= 128 not supported");
+    bool is_alphanumeric =
+        (escaped >= 'a' && escaped <= 'z') || (escaped >= 'A' && escaped <= 'Z') || (escaped >= '0' && escaped <= '9');
+    if (is_alphanumeric) {
+      error_with_info(regex_parser, "Unknown escape sequence");
       return err;
     }
-    lvalue->entry_id = add_node(regex_parser->fa_context);
-    lvalue->exit_id  = add_node(regex_parser->fa_context);
-    add_transition(regex_parser->fa_context, lvalue->entry_id, peek(regex_parser), lvalue->exit_id);
-    next(regex_parser);
+    *byte = u8(escaped);
     break;
   }
+  members[*byte] = true;
+  return ok;
+}
+
+// Parses the class following a [ up to and including the closing ]
+Result parse_class(RegexParser *regex_parser, bool *members) {
+  bool negated = false;
+  if (!is_end(regex_parser) && peek(regex_parser) == '^') {
+    negated = true;
+    next(regex_parser);
+  }
+
+  bool class_members[256] = {};
+  bool first_item         = true;
+  while (true) {
+    if (is_end(regex_parser)) {
+      error_with_info(regex_parser, "Expected ] to match previous [");
+      return err;
+    }
 
-  while (!is_end(regex_parser)) {
     char current_char = peek(regex_parser);
-    if (current_char == ')') break;
+    if (current_char == ']' && !first_item) {
+      next(regex_parser);
+      break;
+    }
+    first_item = false;
+    next(regex_parser);
+
+    i32 range_first = u8(current_char);
+    if (current_char == '\\' && parse_escape(regex_parser, class_members, &range_first)) return err;
+    if (range_first < 0) continue;
 
-    i8 precedence = 2;
-    switch (current_char) {
-    case '*': precedence = 3; break;
-    case '|': precedence = 1; break;
-    default: break;
+    // A '-' which is not the last character of the class forms a range
+    if (is_end(regex_parser) || peek(regex_parser) != '-' || regex_parser->index + 1 >= regex_parser->regex.len ||
+        regex_parser->regex.str[regex_parser->index + 1] == ']') {
+      class_members[range_first] = true;
+      continue;
     }
+    next(regex_parser);
 
-    if (precedence < min_precedence) break;
+    char last_char = peek(regex_parser);
+    next(regex_parser);
+    i32 range_last = u8(last_char);
+    bool unused_members[256];
+    if (last_char == '\\' && parse_escape(regex_parser, unused_members, &range_last)) return err;
+    if (range_last < 0) {
+      error_with_info(regex_parser, "Character class cannot end a range");
+      return err;
+    }
+    if (range_last < range_first) {
+      error_with_info(regex_parser, "Range is out of order");
+      return err;
+    }
+    add_members(class_members, u32(range_first), u32(range_last));
+  }
 
-    switch (current_char) {
-    case '*': {
-      next(regex_parser);
+  for (u32 byte = 0; byte < 256; ++byte) members[byte] = class_members[byte] != negated;
+  return ok;
+}
 
-      auto star_entry_id = add_node(regex_parser->fa_context);
-      auto star_exit_id  = add_node(regex_parser->fa_context);
-      add_transition(regex_parser->fa_context, lvalue->exit_id, FAEdge::epsilon, lvalue->entry_id);
-      add_transition(regex_parser->fa_context, star_entry_id, FAEdge::epsilon, star_exit_id);
-      add_transition(regex_parser->fa_context, star_entry_id, FAEdge::epsilon, lvalue->entry_id);
-      add_transition(regex_parser->fa_context, lvalue->exit_id, FAEdge::epsilon, star_exit_id);
-      lvalue->entry_id = star_entry_id;
-      lvalue->exit_id  = star_exit_id;
-      break;
+RegexNode *clone_node(RegexParser *regex_parser, RegexNode *node) {
+  if (!node) return nullptr;
+  auto *clone  = make_node(regex_parser, node->kind, nullptr, nullptr);
+  *clone       = *node;
+  clone->left  = clone_node(regex_parser, node->left);
+  clone->right = clone_node(regex_parser, node->right);
+  if (node->kind == RegexNode::set) ++regex_parser->set_count;
+  return clone;
+}
+
+i32 count_sets(RegexNode *node) {
+  if (!node) return 0;
+  return (node->kind == RegexNode::set) + count_sets(node->left) + count_sets(node->right);
+}
+
+Result parse_count(RegexParser *regex_parser, i32 *count) {
+  if (is_end(regex_parser) || peek(regex_parser) < '0' || peek(regex_parser) > '9') {
+    error_with_info(regex_parser, "Expected repetition count");
+    return err;
+  }
+  *count = 0;
+  while (!is_end(regex_parser) && peek(regex_parser) >= '0' && peek(regex_parser) <= '9') {
+    *count = *count * 10 + (peek(regex_parser) - '0');
+    if (*count > max_regex_sets) {
+      error_with_info(regex_parser, "Repetition count is too large");
+      return err;
     }
-    case '|': {
-      next(regex_parser);
+    next(regex_parser);
+  }
+  return ok;
+}
 
-      NFAComponent rvalue;
-      if (parse_infix(regex_parser, &rvalue, precedence)) return err;
+// Parses the counted repetition following a { and expands it into copies of operand
+RegexNode *parse_counted_repetition(RegexParser *regex_parser, RegexNode *operand) {
+  i32 min_count = 0;
+  if (parse_count(regex_parser, &min_count)) return nullptr;
 
-      auto union_entry_id = add_node(regex_parser->fa_context);
-      auto union_exit_id  = add_node(regex_parser->fa_context);
-      add_transition(regex_parser->fa_context, union_entry_id, FAEdge::epsilon, lvalue->entry_id);
-      add_transition(regex_parser->fa_context, union_entry_id, FAEdge::epsilon, rvalue.entry_id);
-      add_transition(regex_parser->fa_context, lvalue->exit_id, FAEdge::epsilon, union_exit_id);
-      add_transition(regex_parser->fa_context, rvalue.exit_id, FAEdge::epsilon, union_exit_id);
+  i32 max_count = min_count;
+  if (!is_end(regex_parser) && peek(regex_parser) == ',') {
+    next(regex_parser);
+    max_count = -1;
+    if (!is_end(regex_parser) && peek(regex_parser) != '}' && parse_count(regex_parser, &max_count)) return nullptr;
+  }
+  if (is_end(regex_parser) || peek(regex_parser) != '}') {
+    error_with_info(regex_parser, "Expected } to end repetition");
+    return nullptr;
+  }
+  next(regex_parser);
 
-      lvalue->entry_id = union_entry_id;
-      lvalue->exit_id  = union_exit_id;
-      break;
+  if (max_count == 0 || (max_count > 0 && max_count < min_count)) {
+    error_with_info(regex_parser, "Invalid repetition bounds");
+    return nullptr;
+  }
+
+  i32 copies = max_count < 0 ? min_count + 1 : max_count;
+  if (regex_parser->set_count + count_sets(operand) * (copies - 1) > max_regex_sets) {
+    error_with_info(regex_parser, "Repetition expands to too many states");
+    return nullptr;
+  }
+
+  // Optional copies nest, so x{1,3} becomes x(x(x)?)?
+  RegexNode *tail = nullptr;
+  if (max_count < 0) {
+    auto *copy = min_count > 0 ? clone_node(regex_parser, operand) : operand;
+    tail       = make_node(regex_parser, RegexNode::star, copy, nullptr);
+  } else {
+    for (i32 i = min_count; i < max_count; ++i) {
+      auto *copy = i == 0 && min_count == 0 ? operand : clone_node(regex_parser, operand);
+      tail       = make_node(regex_parser, RegexNode::optional,
+                             tail ? make_node(regex_parser, RegexNode::concat, copy, tail) : copy, nullptr);
     }
-    default: {
-      NFAComponent rvalue;
-      if (parse_infix(regex_parser, &rvalue, precedence)) return err;
+  }
 
-      add_transition(regex_parser->fa_context, lvalue->exit_id, FAEdge::epsilon, rvalue.entry_id);
-      lvalue->exit_id = rvalue.exit_id;
-      break;
+  RegexNode *result = tail;
+  for (i32 i = min_count - 1; i >= 0; --i) {
+    auto *copy = i == 0 ? operand : clone_node(regex_parser, operand);
+    result     = result ? make_node(regex_parser, RegexNode::concat, copy, result) : copy;
+  }
+  return result;
+}
+
+RegexNode *parse_alternation(RegexParser *regex_parser);
+
+RegexNode *parse_atom(RegexParser *regex_parser) {
+  if (is_end(regex_parser)) {
+    error_with_info(regex_parser, "Expected more characters");
+    return nullptr;
+  }
+
+  bool members[256] = {};
+  char current_char = peek(regex_parser);
+  switch (current_char) {
+  case '|':
+  case '*':
+  case '+':
+  case '?':
+  case '{': error_with_info(regex_parser, "Expected character instead of operator"); return nullptr;
+  case ')': error_with_info(regex_parser, "Unexpected )"); return nullptr;
+  case '(': {
+    next(regex_parser);
+    auto *node = parse_alternation(regex_parser);
+    if (!node) return nullptr;
+    if (is_end(regex_parser) || peek(regex_parser) != ')') {
+      error_with_info(regex_parser, "Expected ) to match previous (");
+      return nullptr;
     }
+    next(regex_parser);
+    return node;
+  }
+  case '[':
+    next(regex_parser);
+    if (parse_class(regex_parser, members)) return nullptr;
+    break;
+  case '.':
+    next(regex_parser);
+    add_members(members, 0, 255);
+    members['\n'] = false;
+    break;
+  case '\\': {
+    next(regex_parser);
+    i32 unused_byte;
+    if (parse_escape(regex_parser, members, &unused_byte)) return nullptr;
+    break;
+  }
+  default:
+    next(regex_parser);
+    members[u8(current_char)] = true;
+    break;
+  }
+
+  if (regex_parser->set_count >= max_regex_sets) {
+    error_with_info(regex_parser, "Regex has too many states");
+    return nullptr;
+  }
+  return make_set(regex_parser, members);
+}
+
+RegexNode *parse_repetition(RegexParser *regex_parser) {
+  auto *node = parse_atom(regex_parser);
+  while (node && !is_end(regex_parser)) {
+    switch (peek(regex_parser)) {
+    case '*': next(regex_parser); node = make_node(regex_parser, RegexNode::star, node, nullptr); break;
+    case '+': next(regex_parser); node = make_node(regex_parser, RegexNode::plus, node, nullptr); break;
+    case '?': next(regex_parser); node = make_node(regex_parser, RegexNode::optional, node, nullptr); break;
+    case '{':
+      next(regex_parser);
+      node = parse_counted_repetition(regex_parser, node);
+      break;
+    default: return node;
     }
   }
-  return ok;
+  return node;
+}
+
+RegexNode *parse_concatenation(RegexParser *regex_parser) {
+  auto *node = parse_repetition(regex_parser);
+  while (node && !is_end(regex_parser) && peek(regex_parser) != '|' && peek(regex_parser) != ')') {
+    auto *right = parse_repetition(regex_parser);
+    if (!right) return nullptr;
+    node = make_node(regex_parser, RegexNode::concat, node, right);
+  }
+  return node;
+}
+
+RegexNode *parse_alternation(RegexParser *regex_parser) {
+  auto *node = parse_concatenation(regex_parser);
+  while (node && !is_end(regex_parser) && peek(regex_parser) == '|') {
+    next(regex_parser);
+    auto *right = parse_concatenation(regex_parser);
+    if (!right) return nullptr;
+    node = make_node(regex_parser, RegexNode::alternate, node, right);
+  }
+  return node;
 }
 
-Node<FANode, FAEdge> *generate_nfa(FAContext *fa_context, u32 accept_token, StringRef regex) {
+RegexNode *parse_regex(Allocator *allocator, StringRef regex) {
   RegexParser regex_parser;
-  regex_parser.index      = 0;
-  regex_parser.regex      = regex;
-  regex_parser.fa_context = fa_context;
+  regex_parser.index     = 0;
+  regex_parser.regex     = regex;
+  regex_parser.allocator = allocator;
+  regex_parser.set_count = 0;
+
+  auto *root = parse_alternation(&regex_parser);
+  if (root && !is_end(&regex_parser)) {
+    error_with_info(&regex_parser, "Unexpected )");
+    return nullptr;
+  }
+  return root;
+}
+
+struct NFAComponent {
+  FANodeId entry_id;
+  FANodeId exit_id;
+};
+
+// Thompson construction, each set becomes one edge per range
+void build_nfa(FAContext *fa_context, RegexNode *node, NFAComponent *component) {
+  switch (node->kind) {
+  case RegexNode::set:
+    component->entry_id = add_node(fa_context);
+    component->exit_id  = add_node(fa_context);
+    for (i32 i = 0; i < node->range_count; ++i) {
+      add_transition(fa_context, component->entry_id, node->ranges[i].first, node->ranges[i].last, component->exit_id);
+    }
+    break;
+  case RegexNode::concat: {
+    NFAComponent right;
+    build_nfa(fa_context, node->left, component);
+    build_nfa(fa_context, node->right, &right);
+    add_epsilon_transition(fa_context, component->exit_id, right.entry_id);
+    component->exit_id = right.exit_id;
+    break;
+  }
+  case RegexNode::alternate: {
+    NFAComponent left;
+    NFAComponent right;
+    build_nfa(fa_context, node->left, &left);
+    build_nfa(fa_context, node->right, &right);
+
+    component->entry_id = add_node(fa_context);
+    component->exit_id  = add_node(fa_context);
+    add_epsilon_transition(fa_context, component->entry_id, left.entry_id);
+    add_epsilon_transition(fa_context, component->entry_id, right.entry_id);
+    add_epsilon_transition(fa_context, left.exit_id, component->exit_id);
+    add_epsilon_transition(fa_context, right.exit_id, component->exit_id);
+    break;
+  }
+  case RegexNode::star:
+  case RegexNode::plus:
+  case RegexNode::optional: {
+    NFAComponent operand;
+    build_nfa(fa_context, node->left, &operand);
+
+    component->entry_id = add_node(fa_context);
+    component->exit_id  = add_node(fa_context);
+    add_epsilon_transition(fa_context, component->entry_id, operand.entry_id);
+    add_epsilon_transition(fa_context, operand.exit_id, component->exit_id);
+    if (node->kind != RegexNode::plus) add_epsilon_transition(fa_context, component->entry_id, component->exit_id);
+    if (node->kind != RegexNode::optional) add_epsilon_transition(fa_context, operand.exit_id, operand.entry_id);
+    break;
+  }
+  }
+}
+
+FAGraphNode *generate_nfa(FAContext *fa_context, u32 accept_token, u32 accept_priority, StringRef regex) {
+  // The tree is only needed until the nfa is built
+  BumpScope regex_scope(&fa_context->scratch_allocator);
+  auto *root = parse_regex(&fa_context->scratch_allocator, regex);
+  if (!root) return nullptr;
 
   NFAComponent result_nfa;
-  if (parse_infix(&regex_parser, &result_nfa, 0)) return nullptr;
+  build_nfa(fa_context, root, &result_nfa);
 
-  fa_context->graph.nodes.get(result_nfa.exit_id)->data.accept_token = accept_token;
+  auto *exit_node                 = fa_context->graph.nodes.get(result_nfa.exit_id);
+  exit_node->data.accept_token    = accept_token;
+  exit_node->data.accept_priority = accept_priority;
 
   return fa_context->graph.nodes.get(result_nfa.entry_id);
 }
@@ -4,10 +4,44 @@
 #include "common/adt/string.hpp"
 #include "common/general.hpp"
 #include "common/lexer/lexer.hpp"
+#include "common/mem.hpp"
 
 namespace ucl {
 
-Node<FANode, FAEdge> *generate_nfa(FAContext *fa_context, u32 accept_token, StringRef regex);
+struct RegexRange {
+  u8 first;
+  u8 last;
+};
+
+struct RegexNode {
+  enum Kind : u8 {
+    set,       // Matches one byte from ranges
+    concat,    // left then right
+    alternate, // left or right
+    star,      // left zero or more times
+    plus,      // left one or more times
+    optional,  // left zero or one time
+  };
+
+  Kind kind;
+
+  // Sorted, disjoint and non adjacent ranges of a set
+  RegexRange *ranges;
+  i32 range_count;
+
+  RegexNode *left;
+  RegexNode *right;
+};
+
+// Counted repetition is expanded into copies, so the expanded regex may not exceed this many sets
+const i32 max_regex_sets = 4096;
+
+// Supports literals, escapes, '.', character classes, '|', '*', '+', '?', '{m}', '{m,}', '{m,n}' and parentheses
+RegexNode *parse_regex(Allocator *allocator, StringRef regex);
+
+i32 count_sets(RegexNode *node);
+
+FAGraphNode *generate_nfa(FAContext *fa_context, u32 accept_token, u32 accept_priority, StringRef regex);
 
 } // namespace ucl
 
@@ -0,0 +1,77 @@
+#include "common/lexer/scanner.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ucl {
+
+Result map_source_file(SourceFile *source_file, cstr path) {
+  i32 fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    error("Could not open '%s'\n", path);
+    return err;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    error("Could not stat '%s'\n", path);
+    close(fd);
+    return err;
+  }
+
+  source_file->length = i64(file_stat.st_size);
+  source_file->data   = nullptr;
+  if (source_file->length > 0) {
+    void *mapping = mmap(nullptr, usize(source_file->length), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      error("Could not map '%s'\n", path);
+      close(fd);
+      return err;
+    }
+    madvise(mapping, usize(source_file->length), MADV_SEQUENTIAL);
+    source_file->data = (cstr)mapping;
+  }
+
+  close(fd);
+  return ok;
+}
+
+void unmap_source_file(SourceFile *source_file) {
+  if (source_file->data) munmap((void *)source_file->data, usize(source_file->length));
+  source_file->data   = nullptr;
+  source_file->length = 0;
+}
+
+bool next_token(Scanner *scanner, Token *token) {
+  cstr start = scanner->current;
+  if (start == scanner->end) return false;
+
+  auto *transitions   = scanner->dfa->transitions;
+  auto *accept_tokens = scanner->dfa->accept_tokens;
+  auto *class_map     = scanner->dfa->class_map;
+  u32 class_count     = scanner->dfa->class_count;
+
+  u32 state        = scanner->dfa->start_state;
+  u32 accept_token = FANode::no_accept;
+  cstr accept_end  = start + 1;
+  cstr current     = start;
+  while (current != scanner->end) {
+    state = transitions[state * class_count + class_map[u8(*current++)]];
+    if (state == DFA::dead_state) break;
+    if (accept_tokens[state] != FANode::no_accept) {
+      accept_token = accept_tokens[state];
+      accept_end   = current;
+    }
+  }
+
+  token->accept_token    = accept_token;
+  token->text.str        = start;
+  token->text.len        = i32(accept_end - start);
+  scanner->current       = accept_end;
+  scanner->lookahead_end = current;
+  return true;
+}
+
+} // namespace ucl
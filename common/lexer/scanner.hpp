@@ -0,0 +1,48 @@
+#ifndef COMMON_LEXER_SCANNER_HPP
+#define COMMON_LEXER_SCANNER_HPP
+
+#include "common/adt/string.hpp"
+#include "common/general.hpp"
+#include "common/lexer/dfa.hpp"
+
+namespace ucl {
+
+// Read only view of a file mapped into memory
+struct SourceFile {
+  cstr data;
+  i64 length;
+};
+
+Result map_source_file(SourceFile *source_file, cstr path);
+
+void unmap_source_file(SourceFile *source_file);
+
+// Tokens point into the scanned buffer and are never copied
+struct Token {
+  u32 accept_token; // FANode::no_accept for a byte which does not start any token
+  StringRef text;
+};
+
+struct Scanner {
+  void init(DFA *scanner_dfa, cstr source_begin, cstr source_end) {
+    dfa           = scanner_dfa;
+    current       = source_begin;
+    end           = source_end;
+    lookahead_end = source_begin;
+  }
+
+  DFA *dfa;
+  cstr current;
+  cstr end;
+  cstr lookahead_end; // One past the last byte examined while scanning the previous token
+};
+
+// Scans the longest token at the current position, returns false once the input is exhausted
+bool next_token(Scanner *scanner, Token *token);
+
+// Either next_token over dfa tables or a generated scanner
+using NextTokenFn = bool (*)(Scanner *scanner, Token *token);
+
+} // namespace ucl
+
+#endif
@@ -0,0 +1,153 @@
+#include "common/lexer/shift_and.hpp"
+
+#include "common/lexer/regex.hpp"
+
+namespace ucl {
+
+struct GlushkovSets {
+  u64 first;
+  u64 last;
+  bool nullable;
+};
+
+struct GlushkovBuilder {
+  ShiftAndMatcher *matcher;
+  u64 follow[ShiftAndMatcher::max_positions];
+};
+
+void add_follow(GlushkovBuilder *builder, u64 sources, u64 destinations) {
+  for (; sources; sources &= sources - 1) builder->follow[__builtin_ctzll(sources)] |= destinations;
+}
+
+// Caller checks the number of sets first, so every set gets a position
+void build_glushkov(GlushkovBuilder *builder, RegexNode *node, GlushkovSets *sets) {
+  auto *matcher = builder->matcher;
+  switch (node->kind) {
+  case RegexNode::set: {
+    u64 position = u64(1) << u32(matcher->position_count++);
+    for (i32 i = 0; i < node->range_count; ++i) {
+      for (u32 byte = node->ranges[i].first; byte <= node->ranges[i].last; ++byte) {
+        matcher->byte_masks[byte] |= position;
+      }
+    }
+    sets->first    = position;
+    sets->last     = position;
+    sets->nullable = false;
+    break;
+  }
+  case RegexNode::concat: {
+    GlushkovSets right;
+    build_glushkov(builder, node->left, sets);
+    build_glushkov(builder, node->right, &right);
+    add_follow(builder, sets->last, right.first);
+    if (sets->nullable) sets->first |= right.first;
+    sets->last     = right.nullable ? sets->last | right.last : right.last;
+    sets->nullable = sets->nullable && right.nullable;
+    break;
+  }
+  case RegexNode::alternate: {
+    GlushkovSets right;
+    build_glushkov(builder, node->left, sets);
+    build_glushkov(builder, node->right, &right);
+    sets->first |= right.first;
+    sets->last |= right.last;
+    sets->nullable = sets->nullable || right.nullable;
+    break;
+  }
+  case RegexNode::star:
+  case RegexNode::plus:
+  case RegexNode::optional:
+    build_glushkov(builder, node->left, sets);
+    if (node->kind != RegexNode::optional) add_follow(builder, sets->last, sets->first);
+    if (node->kind != RegexNode::plus) sets->nullable = true;
+    break;
+  }
+}
+
+Result compile_shift_and(Allocator *allocator, ShiftAndMatcher *matcher, StringRef regex) {
+  GlushkovBuilder builder;
+  builder.matcher = matcher;
+  memory_clear(builder.follow, ShiftAndMatcher::max_positions);
+  memory_clear(matcher->byte_masks, 256);
+  matcher->position_count = 0;
+
+  GlushkovSets sets;
+  {
+    // The tree is only needed until the follow sets are known
+    BumpScope regex_scope(allocator);
+    auto *root = parse_regex(allocator, regex);
+    if (!root) return err;
+    if (count_sets(root) > ShiftAndMatcher::max_positions) {
+      error("Regex '%.*s' has more than %d positions\n", regex.len, regex.str, ShiftAndMatcher::max_positions);
+      return err;
+    }
+    build_glushkov(&builder, root, &sets);
+  }
+  matcher->first    = sets.first;
+  matcher->last     = sets.last;
+  matcher->nullable = sets.nullable;
+
+  // Split each follow set into the edge to the next position, the loop and whatever is left for the jump tables
+  matcher->shift_mask = 0;
+  matcher->loop_mask  = 0;
+  matcher->jump_mask  = 0;
+  u64 jumps[ShiftAndMatcher::max_positions];
+  for (i32 position = 0; position < matcher->position_count; ++position) {
+    u64 bit     = u64(1) << u32(position);
+    u64 follows = builder.follow[position];
+    if (follows & (bit << 1U)) matcher->shift_mask |= bit << 1U;
+    if (follows & bit) matcher->loop_mask |= bit;
+    jumps[position] = follows & ~(bit | (bit << 1U));
+    if (jumps[position]) matcher->jump_mask |= bit;
+  }
+
+  matcher->jump_chunk_count = 0;
+  for (i32 chunk = 0; chunk < ShiftAndMatcher::chunk_count; ++chunk) {
+    if (!((matcher->jump_mask >> u32(chunk * 8)) & 0xFFU)) continue;
+
+    auto *table = allocator->construct<u64>(256);
+    for (u32 value = 0; value < 256; ++value) {
+      table[value] = 0;
+      for (u32 bits = value; bits; bits &= bits - 1) {
+        i32 position = chunk * 8 + __builtin_ctz(bits);
+        if (position < matcher->position_count) table[value] |= jumps[position];
+      }
+    }
+    matcher->jump_chunks[matcher->jump_chunk_count]   = u8(chunk);
+    matcher->jump_tables[matcher->jump_chunk_count++] = table;
+  }
+  return ok;
+}
+
+// Positions reachable in one step from the active positions, before the next byte filters them
+u64 shift_and_follow(ShiftAndMatcher *matcher, u64 state) {
+  u64 next    = ((state << 1U) & matcher->shift_mask) | (state & matcher->loop_mask);
+  u64 jumping = state & matcher->jump_mask;
+  for (i32 i = 0; jumping && i < matcher->jump_chunk_count; ++i) {
+    next |= matcher->jump_tables[i][(jumping >> u32(matcher->jump_chunks[i] * 8)) & 0xFFU];
+  }
+  return next;
+}
+
+bool shift_and_match(ShiftAndMatcher *matcher, cstr begin, cstr end) {
+  if (begin == end) return matcher->nullable;
+
+  u64 state = matcher->first & matcher->byte_masks[u8(*begin)];
+  for (cstr current = begin + 1; state && current < end; ++current) {
+    state = shift_and_follow(matcher, state) & matcher->byte_masks[u8(*current)];
+  }
+  return state & matcher->last;
+}
+
+i64 shift_and_search(ShiftAndMatcher *matcher, cstr begin, cstr end) {
+  if (matcher->nullable) return 0;
+
+  u64 state = 0;
+  for (cstr current = begin; current < end; ++current) {
+    state = (shift_and_follow(matcher, state) | matcher->first) & matcher->byte_masks[u8(*current)];
+    if (state & matcher->last) return current + 1 - begin;
+  }
+  return -1;
+}
+
+} // namespace ucl
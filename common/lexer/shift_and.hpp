@@ -0,0 +1,44 @@
+#ifndef COMMON_LEXER_SHIFT_AND_HPP
+#define COMMON_LEXER_SHIFT_AND_HPP
+
+#include "common/adt/string.hpp"
+#include "common/general.hpp"
+#include "common/mem.hpp"
+
+namespace ucl {
+
+// Glushkov position automaton of a small regex, simulated with one bit per position instead of being determinized.
+// Positions are numbered left to right, so most follow edges either go to the next position or loop on one position.
+// Those are a shift and a mask per byte, the remaining edges go through one table lookup per byte of active positions
+struct ShiftAndMatcher {
+  static const i32 max_positions = 64;
+  static const i32 chunk_count   = max_positions / 8;
+
+  u64 byte_masks[256]; // Positions whose set contains the byte
+  u64 first;           // Positions a match can start with
+  u64 last;            // Positions a match can end with
+  u64 shift_mask;      // Position p + 1 is set when it follows position p
+  u64 loop_mask;       // Position p is set when it follows itself
+  u64 jump_mask;       // Positions with any other follow edge
+  bool nullable;       // Matches the empty string
+  i32 position_count;
+
+  // Follow sets of the jump positions in one byte of the state, indexed by the value of that byte
+  i32 jump_chunk_count;
+  u8 jump_chunks[chunk_count];
+  u64 *jump_tables[chunk_count];
+};
+
+// Fails when the regex does not parse or has more than max_positions sets after counted repetition is expanded.
+// The jump tables are allocated in allocator
+Result compile_shift_and(Allocator *allocator, ShiftAndMatcher *matcher, StringRef regex);
+
+// True when the whole text matches
+bool shift_and_match(ShiftAndMatcher *matcher, cstr begin, cstr end);
+
+// Offset one past the first byte at which some match ends, -1 without a match. A nullable regex matches at offset 0
+i64 shift_and_search(ShiftAndMatcher *matcher, cstr begin, cstr end);
+
+} // namespace ucl
+
+#endif
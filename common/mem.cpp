@@ -2,14 +2,225 @@
 
 namespace ucl {
 
+ArenaStats unnamed_arena_stats{"unnamed"};
+
+AllocationSite bump_chunk_site{"bump_chunk", 0};
+
 #if DEBUG
 GlobalMemoryStats global_mem_statistics;
+
+std::atomic<AllocationSite *> registered_sites{nullptr};
+std::atomic<ArenaStats *> registered_arenas{nullptr};
+
+void register_site(AllocationSite *site) {
+  if (site->registered.exchange(true)) return;
+
+  // Sites of types are named by the template argument of type_site
+  cstr type_argument = strstr(site->name, "T = ");
+  if (type_argument) {
+    site->name        = type_argument + 4;
+    site->name_length = i32(strcspn(site->name, ";]"));
+  } else {
+    site->name_length = i32(strlen(site->name));
+  }
+
+  site->next = registered_sites.load();
+  while (!registered_sites.compare_exchange_weak(site->next, site)) {
+  }
+}
+
+void register_arena(ArenaStats *arena_stats) {
+  if (arena_stats->registered.exchange(true)) return;
+  arena_stats->next = registered_arenas.load();
+  while (!registered_arenas.compare_exchange_weak(arena_stats->next, arena_stats)) {
+  }
+}
+#endif
+
+void release_chunk(BumpAllocator *allocator, BumpChunk *chunk) {
+  if (allocator->spare_chunk && allocator->spare_chunk->capacity >= chunk->capacity) {
+    CAllocator::destruct(chunk);
+    return;
+  }
+  if (allocator->spare_chunk) CAllocator::destruct(allocator->spare_chunk);
+  allocator->spare_chunk = chunk;
+}
+
+void BumpAllocator::destroy() {
+  ASSERT_MEMCHECK
+  while (chunk) {
+    auto *previous = chunk->previous;
+    CAllocator::destruct(chunk);
+    chunk = previous;
+  }
+  if (spare_chunk) CAllocator::destruct(spare_chunk);
+  DESTROY_MEMCHECK
+}
+
+void BumpAllocator::reset_to(BumpMarker marker) {
+  ASSERT_MEMCHECK
+  while (chunk != marker.chunk) {
+    auto *previous = chunk->previous;
+    release_chunk(this, chunk);
+    chunk = previous;
+  }
+
+  data     = chunk ? (i8 *)(chunk + 1) : nullptr;
+  capacity = chunk ? chunk->capacity : 0;
+  offset   = marker.offset;
+}
+
+i8 *BumpAllocator::allocate_chunk(size bytes) {
+  size new_capacity = chunk ? chunk->capacity * 2 : initial_capacity;
+  while (new_capacity < bytes) new_capacity *= 2;
+
+  BumpChunk *new_chunk;
+  if (spare_chunk && spare_chunk->capacity >= bytes) {
+    new_chunk   = spare_chunk;
+    spare_chunk = nullptr;
+  } else {
+    new_chunk = (BumpChunk *)CAllocator::construct<i8>(size(sizeof(BumpChunk)) + new_capacity, &bump_chunk_site);
+    if (!new_chunk) panic("BumpAllocator could not allocate a chunk of %ld bytes\n", new_capacity);
+    new_chunk->capacity = new_capacity;
+  }
+
+#if DEBUG
+  GlobalMemoryStats::count(&global_mem_statistics.bytes_wasted, capacity - offset);
+#endif
+
+  // The tail of the previous chunk is abandoned, reset_to still finds its marker offset through the chain
+  new_chunk->previous = chunk;
+  new_chunk->base     = allocated_bytes();
+  chunk               = new_chunk;
+  data                = (i8 *)(new_chunk + 1);
+  capacity            = new_chunk->capacity;
+  offset              = bytes;
+#if DEBUG
+  record_position();
 #endif
+  return data;
+}
+
+void ArenaPool::init(ArenaStats *stats) {
+  pthread_mutex_init(&mutex, nullptr);
+  arena_stats    = stats;
+  free_arenas    = nullptr;
+  acquired_count = 0;
+}
+
+void ArenaPool::destroy() {
+  if (acquired_count) panic("ArenaPool destroyed while %d arenas are still acquired\n", acquired_count);
+  while (free_arenas) {
+    auto *next = free_arenas->next;
+    free_arenas->arena.destroy();
+    CAllocator::destruct(free_arenas);
+    free_arenas = next;
+  }
+  pthread_mutex_destroy(&mutex);
+}
+
+BumpAllocator *ArenaPool::acquire() {
+  pthread_mutex_lock(&mutex);
+  auto *pooled_arena = free_arenas;
+  if (pooled_arena) free_arenas = pooled_arena->next;
+  ++acquired_count;
+  pthread_mutex_unlock(&mutex);
+
+  if (!pooled_arena) {
+    pooled_arena = CAllocator::construct<PooledArena>();
+    pooled_arena->arena.init(arena_stats);
+  }
+  return &pooled_arena->arena;
+}
+
+void ArenaPool::release(BumpAllocator *arena) {
+  arena->reset_to(BumpMarker{nullptr, 0});
+
+  auto *pooled_arena = (PooledArena *)arena;
+  pthread_mutex_lock(&mutex);
+  pooled_arena->next = free_arenas;
+  free_arenas        = pooled_arena;
+  --acquired_count;
+  pthread_mutex_unlock(&mutex);
+}
+
+ArenaStats thread_arena_stats{"thread"};
+
+struct ThreadArena {
+  ~ThreadArena() {
+    if (initialized) arena.destroy();
+  }
+
+  BumpAllocator arena;
+  bool initialized;
+};
+
+thread_local ThreadArena thread_arena_storage;
 
+BumpAllocator *thread_arena() {
+  if (!thread_arena_storage.initialized) {
+    thread_arena_storage.arena.init(&thread_arena_stats);
+    thread_arena_storage.initialized = true;
+  }
+  return &thread_arena_storage.arena;
+}
+
+#if DEBUG
 void GlobalMemoryStats::print_memory_usage() {
-  printf("Bytes Requested: %8db\n", bytes_requested);
-  printf("Bytes Used:      %8db\n", bytes_used);
-  printf("Bytes Malloc'd:  %8db\n", bytes_malloc);
+  printf("Bytes Requested: %8ldb\n", bytes_requested.load());
+  printf("Bytes Used:      %8ldb\n", bytes_used.load());
+  printf("Bytes Malloc'd:  %8ldb\n", bytes_malloc.load());
+  printf("Bytes Wasted:    %8ldb\n", bytes_wasted.load());
+}
+
+void write_json_string(FILE *out, cstr string, i32 length) {
+  fputc('"', out);
+  for (i32 i = 0; i < length; ++i) {
+    if (string[i] == '"' || string[i] == '\\') fputc('\\', out);
+    fputc(string[i], out);
+  }
+  fputc('"', out);
+}
+
+i32 compare_site_bytes(const void *site1, const void *site2) {
+  i64 bytes1 = (*(AllocationSite *const *)site1)->bytes.load();
+  i64 bytes2 = (*(AllocationSite *const *)site2)->bytes.load();
+  return (bytes1 < bytes2) - (bytes1 > bytes2);
 }
 
+void GlobalMemoryStats::write_json(FILE *out) {
+  fprintf(out, "{\n  \"totals\": {\"bytes_requested\": %ld, \"bytes_used\": %ld, \"bytes_malloc\": %ld, "
+               "\"bytes_wasted\": %ld},\n",
+          bytes_requested.load(), bytes_used.load(), bytes_malloc.load(), bytes_wasted.load());
+
+  // Sites are listed by bytes, largest first
+  i32 site_count = 0;
+  for (auto *site = registered_sites.load(); site; site = site->next) ++site_count;
+  auto **sites = (AllocationSite **)malloc(usize(site_count) * sizeof(AllocationSite *));
+  i32 index    = 0;
+  for (auto *site = registered_sites.load(); site && index < site_count; site = site->next) sites[index++] = site;
+  qsort(sites, usize(index), sizeof(AllocationSite *), compare_site_bytes);
+
+  fprintf(out, "  \"sites\": [");
+  for (i32 i = 0; i < index; ++i) {
+    fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+    write_json_string(out, sites[i]->name, sites[i]->name_length);
+    fprintf(out, ", \"allocations\": %ld, \"bytes\": %ld}", sites[i]->allocations.load(), sites[i]->bytes.load());
+  }
+  fprintf(out, "\n  ],\n");
+  free(sites);
+
+  fprintf(out, "  \"arenas\": [");
+  bool first_arena = true;
+  for (auto *arena_stats = registered_arenas.load(); arena_stats; arena_stats = arena_stats->next) {
+    fprintf(out, "%s\n    {\"name\": ", first_arena ? "" : ",");
+    write_json_string(out, arena_stats->name, i32(strlen(arena_stats->name)));
+    fprintf(out, ", \"instances\": %ld, \"peak_bytes\": %ld}", arena_stats->instances.load(),
+            arena_stats->peak_bytes.load());
+    first_arena = false;
+  }
+  fprintf(out, "\n  ]\n}\n");
+}
+#endif
+
 } // namespace ucl
@@ -2,26 +2,86 @@
 #define COMMON_MEM_HPP
 
 #include "common/general.hpp"
+#include <atomic>
+#include <cstring>
 #include <malloc.h>
+#include <pthread.h>
 
 namespace ucl {
 
+// Counters of the allocations made for one type or caller supplied tag. Sites register themselves on first use
+struct AllocationSite {
+  cstr name; // A __PRETTY_FUNCTION__ naming the type for sites created by type_site
+  i32 name_length;
+
+  std::atomic<i64> allocations{0};
+  std::atomic<i64> bytes{0};
+
+  std::atomic<bool> registered{false};
+  AllocationSite *next = nullptr;
+};
+
+// High-water mark shared by every arena with the same name
+struct ArenaStats {
+  cstr name;
+
+  std::atomic<i64> instances{0};
+  std::atomic<i64> peak_bytes{0}; // Largest number of bytes a single arena had allocated at once
+
+  std::atomic<bool> registered{false};
+  ArenaStats *next = nullptr;
+};
+
+extern ArenaStats unnamed_arena_stats;
+
+template <typename T>
+AllocationSite *type_site() {
+  static AllocationSite site{__PRETTY_FUNCTION__, 0};
+  return &site;
+}
+
 #if DEBUG
+void register_site(AllocationSite *site);
+
+void register_arena(ArenaStats *arena_stats);
+
+inline void record_allocation(AllocationSite *site, i64 allocations, i64 bytes) {
+  site->allocations.fetch_add(allocations, std::memory_order_relaxed);
+  site->bytes.fetch_add(bytes, std::memory_order_relaxed);
+  if (!site->registered.load(std::memory_order_acquire)) register_site(site);
+}
+
+inline void record_peak(ArenaStats *arena_stats, i64 bytes) {
+  i64 peak_bytes = arena_stats->peak_bytes.load(std::memory_order_relaxed);
+  while (peak_bytes < bytes && !arena_stats->peak_bytes.compare_exchange_weak(peak_bytes, bytes)) {
+  }
+}
+
+// Shared by every thread, counters are relaxed atomics as only their totals matter
 extern struct GlobalMemoryStats {
   void print_memory_usage();
 
-  i32 bytes_requested = 0;
-  i32 bytes_used      = 0;
-  i32 bytes_malloc    = 0;
+  // Totals, allocation sites and arena high-water marks as a single json object
+  void write_json(FILE *out);
+
+  static void count(std::atomic<i64> *counter, i64 amount) { counter->fetch_add(amount, std::memory_order_relaxed); }
+
+  std::atomic<i64> bytes_requested{0};
+  std::atomic<i64> bytes_used{0};
+  std::atomic<i64> bytes_malloc{0};
+  std::atomic<i64> bytes_wasted{0}; // Abandoned by arena users and chunk tails, unusable until the arena is reset
 } global_mem_statistics;
 #endif
 
 // Simple allocator which is just a wrapper for malloc and free
 struct CAllocator {
   template <typename T>
-  static T *construct(size bytes = 1) {
+  static T *construct(size bytes = 1, AllocationSite *site = nullptr) {
 #if DEBUG
-    global_mem_statistics.bytes_malloc += bytes * size(sizeof(T));
+    GlobalMemoryStats::count(&global_mem_statistics.bytes_malloc, bytes * size(sizeof(T)));
+    record_allocation(site ? site : type_site<T>(), 1, bytes * size(sizeof(T)));
+#else
+    (void)site;
 #endif
     return (T *)malloc(usize(bytes) * sizeof(T));
   }
@@ -32,47 +92,172 @@ struct CAllocator {
   }
 };
 
+// Header in front of every chunk of a BumpAllocator
+struct BumpChunk {
+  BumpChunk *previous;
+  size capacity;
+  size base; // Bytes allocated from the previous chunks
+};
+
+// Allocation position of a BumpAllocator which it can be reset to
+struct BumpMarker {
+  BumpChunk *chunk;
+  size offset;
+};
+
+// Arena allocating from a chain of chunks, each chunk is at least twice the size of the previous one
 struct BumpAllocator {
-  static const i32 capacity = 1024 * 1024;
+  static const size initial_capacity = 64 * 1024;
 
-  void init() {
+  void init(ArenaStats *stats = nullptr) {
     INIT_MEMCHECK
-    offset = 0;
-    data   = CAllocator::construct<i8>(capacity);
+    chunk       = nullptr;
+    spare_chunk = nullptr;
+    data        = nullptr;
+    offset      = 0;
+    capacity    = 0;
+#if DEBUG
+    arena_stats = stats ? stats : &unnamed_arena_stats;
+    peak_bytes  = 0;
+    arena_stats->instances.fetch_add(1, std::memory_order_relaxed);
+    if (!arena_stats->registered.load(std::memory_order_acquire)) register_arena(arena_stats);
+#else
+    (void)stats;
+#endif
   }
 
-  void destroy() {
-    CAllocator::destruct(data);
-    DESTROY_MEMCHECK
+  void destroy();
+
+  // Ensure all allocations are aligned to the size of a pointer
+  static size align_bytes(size bytes) {
+    size pointer_size = size(sizeof(intptr_t));
+    return (bytes + pointer_size - 1) & ~(pointer_size - 1);
   }
 
+  // Allocations are counted against site, or against the site of T when no site is given
   template <typename T>
-  T *construct(size bytes = 1) {
+  T *construct(size bytes = 1, AllocationSite *site = nullptr) {
     ASSERT_MEMCHECK
+    size aligned_bytes = align_bytes(size(sizeof(T)) * bytes);
 
-    // Ensure all allocations are aligned to the size of a pointer
-    size pointer_size = size(sizeof(intptr_t));
-    i32 aligned_bytes = i32((size(sizeof(T)) * bytes + pointer_size - 1) & ~(pointer_size - 1));
+#if DEBUG
+    GlobalMemoryStats::count(&global_mem_statistics.bytes_requested, size(sizeof(T)) * bytes);
+    GlobalMemoryStats::count(&global_mem_statistics.bytes_used, aligned_bytes);
+    record_allocation(site ? site : type_site<T>(), 1, size(sizeof(T)) * bytes);
+#else
+    (void)site;
+#endif
+    if (offset + aligned_bytes > capacity) return (T *)allocate_chunk(aligned_bytes);
 
+    T *pointer = (T *)(data + offset);
+    offset += aligned_bytes;
 #if DEBUG
-    global_mem_statistics.bytes_requested += size(sizeof(T)) * bytes;
-    global_mem_statistics.bytes_used += aligned_bytes;
-    if (offset + aligned_bytes <= capacity) {
+    record_position();
 #endif
-      T *pointer = (T *)(data + offset);
-      offset += aligned_bytes;
-      return pointer;
+    return pointer;
+  }
+
+  // Resizes the last allocation in place, fails when pointer is not the last allocation or the chunk is too small
+  template <typename T>
+  bool try_extend(T *pointer, size old_count, size new_count) {
+    ASSERT_MEMCHECK
+    size old_bytes = align_bytes(size(sizeof(T)) * old_count);
+    size new_bytes = align_bytes(size(sizeof(T)) * new_count);
+    if (!pointer || (i8 *)pointer + old_bytes != data + offset) return false;
+    if (offset - old_bytes + new_bytes > capacity) return false;
+
+#if DEBUG
+    GlobalMemoryStats::count(&global_mem_statistics.bytes_requested, size(sizeof(T)) * (new_count - old_count));
+    GlobalMemoryStats::count(&global_mem_statistics.bytes_used, new_bytes - old_bytes);
+    record_allocation(type_site<T>(), 0, size(sizeof(T)) * (new_count - old_count));
+#endif
+    offset += new_bytes - old_bytes;
+#if DEBUG
+    record_position();
+#endif
+    return true;
+  }
+
+  // Gives the last allocation back to the arena, any other allocation is wasted until the arena is reset
+  template <typename T>
+  void discard(T *pointer, size count) {
+    ASSERT_MEMCHECK
+    if (try_extend(pointer, count, 0)) return;
 #if DEBUG
-    }
-    panic("BumpAllocator cannot exceed total of %d bytes\n", capacity);
+    GlobalMemoryStats::count(&global_mem_statistics.bytes_wasted, align_bytes(size(sizeof(T)) * count));
 #endif
   }
 
+  BumpMarker mark() { return BumpMarker{chunk, offset}; }
+
+  // Bytes allocated since the arena was initialized, chunk tails left behind are not counted
+  size allocated_bytes() { return (chunk ? chunk->base : 0) + offset; }
+
+#if DEBUG
+  void record_position() {
+    size position = allocated_bytes();
+    if (position <= peak_bytes) return;
+    peak_bytes = position;
+    record_peak(arena_stats, position);
+  }
+#endif
+
+  // Releases everything allocated since marker was taken
+  void reset_to(BumpMarker marker);
+
+  // Starts a new chunk holding at least bytes and returns its first allocation
+  i8 *allocate_chunk(size bytes);
+
+  BumpChunk *chunk;
+  BumpChunk *spare_chunk; // Largest released chunk, reused so repeated rollbacks do not hit malloc
+
+  // Current chunk
   i8 *data;
-  i32 offset;
+  size offset;
+  size capacity;
+
+#if DEBUG
+  ArenaStats *arena_stats;
+  size peak_bytes;
+#endif
   DEFINE_MEMCHECK
 };
 
+// Resets the allocator to where it was when the scope was entered
+struct BumpScope {
+  explicit BumpScope(BumpAllocator *allocator) : allocator(allocator), marker(allocator->mark()) {}
+  ~BumpScope() { allocator->reset_to(marker); }
+
+  BumpScope(const BumpScope &)            = delete;
+  BumpScope &operator=(const BumpScope &) = delete;
+
+  BumpAllocator *allocator;
+  BumpMarker marker;
+};
+
+// Arenas handed out to worker threads. A released arena is rolled back and keeps its largest chunk, so the next
+// user of the pool allocates without going to malloc
+struct ArenaPool {
+  void init(ArenaStats *stats = nullptr);
+  void destroy();
+
+  BumpAllocator *acquire();
+  void release(BumpAllocator *arena);
+
+  struct PooledArena {
+    BumpAllocator arena; // First member, a released arena converts back to its PooledArena
+    PooledArena *next;
+  };
+
+  pthread_mutex_t mutex;
+  ArenaStats *arena_stats; // Shared by every arena of the pool
+  PooledArena *free_arenas;
+  i32 acquired_count;
+};
+
+// Arena private to the calling thread, created on first use and destroyed when the thread exits
+BumpAllocator *thread_arena();
+
 using Allocator = BumpAllocator;
 
 template <typename T>
@@ -87,7 +272,7 @@ void memory_copy(T *destination, T *source, i32 count) {
 template <typename T>
 void memory_clear(T *destination, i32 count) {
 #if DEBUG
-  for (i32 i = 0; i < i32(sizeof(T)) * count; ++i) *(((u8 *)destination) + 1) = 0;
+  for (i32 i = 0; i < i32(sizeof(T)) * count; ++i) *(((u8 *)destination) + i) = 0;
 #else
   memset(destination, 0, usize(count) * sizeof(T));
 #endif
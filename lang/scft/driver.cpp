@@ -1,19 +1,101 @@
 #include "common/adt/graph.hpp"
 #include "common/adt/map.hpp"
 #include "common/adt/string.hpp"
+#include "common/adt/string_interner.hpp"
 #include "common/adt/vec.hpp"
 #include "common/general.hpp"
+#include "common/lexer/dfa_file.hpp"
+#include "common/lexer/lazy_dfa.hpp"
 #include "common/lexer/lexer.hpp"
+#include "common/lexer/line_filter.hpp"
+#include "common/lexer/parallel_scanner.hpp"
+#include "common/lexer/scanner.hpp"
 #include "common/mem.hpp"
+#include "lang/scft/scanner.hpp"
+#include "lang/scft/tokens.hpp"
+
+#include <cctype>
+#include <cerrno>
+
+ucl::ArenaStats driver_arena_stats{"scftc"};
+ucl::ArenaStats scan_arena_stats{"scan_chunks"};
+
+// Prints the lines of the file containing a match of regex, like grep over a build log
+ucl::Result filter_lines(ucl::Allocator *allocator, cstr regex, cstr path) {
+  ucl::LineFilter filter;
+  if (ucl::init_line_filter(allocator, &filter, ucl::strref(regex))) return ucl::err;
+
+  ucl::SourceFile source_file;
+  if (ucl::map_source_file(&source_file, path)) {
+    ucl::destroy_line_filter(&filter);
+    return ucl::err;
+  }
+
+  cstr end = source_file.data + source_file.length;
+  for (cstr line = source_file.data; line < end;) {
+    auto *newline = (cstr)memchr(line, '\n', usize(end - line));
+    cstr line_end = newline ? newline : end;
+    if (ucl::line_matches(&filter, line, line_end)) printf("%.*s\n", i32(line_end - line), line);
+    line = line_end + 1;
+  }
+
+  ucl::unmap_source_file(&source_file);
+  ucl::destroy_line_filter(&filter);
+  return ucl::ok;
+}
+
+// Accepts only a plain decimal number that fits a u32, atoi would wrap "-1" into a huge state count
+ucl::Result parse_count(cstr text, u32 *count) {
+  char *text_end;
+  errno     = 0;
+  u64 value = strtoul(text, &text_end, 10);
+  if (!isdigit(u8(*text)) || *text_end || errno || value > u32(-1)) return ucl::err;
+  *count = u32(value);
+  return ucl::ok;
+}
 
 i32 main(i32 argc, cstr *argv) {
-  if (argc != 2) {
+  // Scanning uses the generated scanner unless --lexer-cache selects the cached table driven one, or --lazy-states
+  // determinizes while scanning with a cache of that many states. --filter only prints the lines matching a regex
+  cstr lexer_cache_dir = nullptr;
+  cstr filter_regex    = nullptr;
+  cstr source_path     = nullptr;
+  cstr mem_stats_path  = nullptr;
+  i32 scan_threads     = 1;
+  u32 lazy_states      = 0;
+  for (i32 i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--lexer-cache") && i + 1 < argc) {
+      lexer_cache_dir = argv[++i];
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      scan_threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--lazy-states") && i + 1 < argc) {
+      if (parse_count(argv[++i], &lazy_states) || !lazy_states) {
+        fprintf(stderr, "err: --lazy-states expects a positive state count, got %s\n", argv[i]);
+        return ucl::err;
+      }
+    } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      filter_regex = argv[++i];
+    } else if (!strcmp(argv[i], "--mem-stats") && i + 1 < argc) {
+      mem_stats_path = argv[++i];
+    } else if (!source_path) {
+      source_path = argv[i];
+    } else {
+      source_path = nullptr;
+      break;
+    }
+  }
+  if (!source_path) {
     fprintf(stderr, "err: expected file to compile");
     return ucl::err;
   }
 
   ucl::BumpAllocator alloc;
-  alloc.init();
+  alloc.init(&driver_arena_stats);
+  if (filter_regex) {
+    ucl::Result result = filter_lines(&alloc, filter_regex, source_path);
+    alloc.destroy();
+    return result;
+  }
 
   ucl::Vec<i32> other;
   other.init();
@@ -56,12 +138,79 @@ i32 main(i32 argc, cstr *argv) {
     printf("map:%d:%d\n", i, *test_map.get(i));
   }
 
-  printf("Compiling %s...\n", argv[1]);
+  printf("Compiling %s...\n", source_path);
+
+  ucl::DFA dfa;
+  ucl::MappedDFA mapped_dfa{nullptr, 0};
+  if (lexer_cache_dir && ucl::load_lexer(&alloc, &dfa, &scft_lexer_spec, lexer_cache_dir, &mapped_dfa)) return ucl::err;
+
+  // The state cache is rebuilt as the input is scanned, so it cannot be shared by scanning threads
+  ucl::LazyDFA lazy_dfa;
+  if (lazy_states && ucl::init_lazy_dfa(&lazy_dfa, &scft_lexer_spec, lazy_states)) return ucl::err;
+  if (lazy_states) scan_threads = 1;
+
+  ucl::SourceFile source_file;
+  if (ucl::map_source_file(&source_file, source_path)) return ucl::err;
+
+  auto *scanner_dfa = lexer_cache_dir ? &dfa : nullptr;
+  auto *next_token  = lexer_cache_dir ? ucl::next_token : scft_next_token;
+  i64 token_count   = 0;
+  i64 invalid_count = 0;
+
+  // Identifiers become symbol ids here, later phases only compare integers
+  ucl::StringInterner identifiers;
+  identifiers.init();
+  if (scan_threads > 1) {
+    ucl::ArenaPool arena_pool;
+    arena_pool.init(&scan_arena_stats);
+    ucl::Vec<ucl::Token> tokens;
+    tokens.init();
+    ucl::scan_parallel(&alloc, &arena_pool, scanner_dfa, next_token, source_file.data,
+                       source_file.data + source_file.length, scan_threads, &tokens);
+    arena_pool.destroy();
+    for (auto *token : tokens) {
+      if (token->accept_token == ucl::FANode::no_accept) ++invalid_count;
+      if (token->accept_token == scft_token_identifier) identifiers.intern(&alloc, token->text);
+    }
+    token_count = tokens.length;
+  } else {
+    ucl::Scanner scanner;
+    scanner.init(scanner_dfa, source_file.data, source_file.data + source_file.length);
+    ucl::Token token;
+    while (lazy_states ? ucl::lazy_next_token(&lazy_dfa, &scanner, &token) : next_token(&scanner, &token)) {
+      if (token.accept_token == ucl::FANode::no_accept) ++invalid_count;
+      if (token.accept_token == scft_token_identifier) identifiers.intern(&alloc, token.text);
+      ++token_count;
+    }
+  }
+  printf("Scanned %ld tokens (%ld invalid, %d distinct identifiers) from %ld bytes\n", token_count, invalid_count,
+         identifiers.size(), source_file.length);
+
+  if (lazy_states) {
+    printf("Lazy dfa: %u cached states, %d flushes\n", lazy_dfa.state_count, lazy_dfa.flush_count);
+    ucl::destroy_lazy_dfa(&lazy_dfa);
+  }
 
-  ucl::generate_lexer();
+  ucl::unmap_source_file(&source_file);
+  ucl::unmap_dfa_file(&mapped_dfa);
 
+#if DEBUG
   ucl::global_mem_statistics.print_memory_usage();
 
+  // Machine readable statistics for tracking memory use across runs
+  if (mem_stats_path) {
+    FILE *mem_stats_file = fopen(mem_stats_path, "w");
+    if (!mem_stats_file) {
+      ucl::error("Could not open '%s'\n", mem_stats_path);
+      return ucl::err;
+    }
+    ucl::global_mem_statistics.write_json(mem_stats_file);
+    fclose(mem_stats_file);
+  }
+#else
+  if (mem_stats_path) ucl::error("Memory statistics are only collected in debug builds\n");
+#endif
+
   ucl::panic("lol\n");
   return 0;
 }
@@ -0,0 +1,31 @@
+#include "common/general.hpp"
+#include "common/lexer/codegen.hpp"
+#include "common/lexer/dfa.hpp"
+#include "common/lexer/lexer.hpp"
+#include "common/mem.hpp"
+#include "lang/scft/tokens.hpp"
+
+// Build time tool which compiles the scft token specification into a direct coded scanner
+i32 main(i32 argc, cstr *argv) {
+  if (argc != 3) {
+    fprintf(stderr, "err: expected output file and scanner function name");
+    return ucl::err;
+  }
+
+  ucl::BumpAllocator alloc;
+  alloc.init();
+
+  ucl::DFA dfa;
+  if (ucl::generate_lexer(&alloc, &dfa, &scft_lexer_spec, nullptr)) return ucl::err;
+
+  FILE *out = fopen(argv[1], "w");
+  if (!out) {
+    ucl::error("Could not open '%s' for writing\n", argv[1]);
+    return ucl::err;
+  }
+  ucl::emit_scanner_source(out, &dfa, argv[2]);
+  fclose(out);
+
+  alloc.destroy();
+  return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef LANG_SCFT_SCANNER_HPP
+#define LANG_SCFT_SCANNER_HPP
+
+#include "common/general.hpp"
+#include "common/lexer/scanner.hpp"
+
+// Generated at build time by scft_lexgen
+bool scft_next_token(ucl::Scanner *scanner, ucl::Token *token);
+
+#endif
@@ -0,0 +1,42 @@
+#include "lang/scft/tokens.hpp"
+
+// Keywords share their lexemes with identifiers and win through their lower priority
+ucl::TokenRule scft_token_rules[] = {
+    {scft_token_whitespace, "[ \\t\\r\\n]+", 1},
+    {scft_token_comment, "//[^\\n]*", 1},
+    {scft_token_identifier, "[a-zA-Z_][a-zA-Z0-9_]*", 1},
+    {scft_token_number, "[0-9]+|0x[0-9a-fA-F]+", 1},
+
+    {scft_token_fn, "fn", 0},
+    {scft_token_let, "let", 0},
+    {scft_token_if, "if", 0},
+    {scft_token_else, "else", 0},
+    {scft_token_while, "while", 0},
+    {scft_token_return, "return", 0},
+
+    {scft_token_left_paren, "\\(", 0},
+    {scft_token_right_paren, "\\)", 0},
+    {scft_token_left_brace, "\\{", 0},
+    {scft_token_right_brace, "\\}", 0},
+    {scft_token_left_bracket, "\\[", 0},
+    {scft_token_right_bracket, "\\]", 0},
+    {scft_token_semicolon, ";", 0},
+    {scft_token_colon, ":", 0},
+    {scft_token_comma, ",", 0},
+    {scft_token_dot, "\\.", 0},
+    {scft_token_arrow, "->", 0},
+    {scft_token_assign, "=", 0},
+    {scft_token_equal, "==", 0},
+    {scft_token_not, "!", 0},
+    {scft_token_not_equal, "!=", 0},
+    {scft_token_less, "<", 0},
+    {scft_token_less_equal, "<=", 0},
+    {scft_token_greater, ">", 0},
+    {scft_token_greater_equal, ">=", 0},
+    {scft_token_plus, "\\+", 0},
+    {scft_token_minus, "-", 0},
+    {scft_token_star, "\\*", 0},
+    {scft_token_slash, "/", 0},
+};
+
+ucl::LexerSpec scft_lexer_spec = {scft_token_rules, i32(sizeof(scft_token_rules) / sizeof(scft_token_rules[0]))};
@@ -0,0 +1,47 @@
+#ifndef LANG_SCFT_TOKENS_HPP
+#define LANG_SCFT_TOKENS_HPP
+
+#include "common/general.hpp"
+#include "common/lexer/lexer.hpp"
+
+enum ScftToken : u32 {
+  scft_token_whitespace,
+  scft_token_comment,
+  scft_token_identifier,
+  scft_token_number,
+
+  scft_token_fn,
+  scft_token_let,
+  scft_token_if,
+  scft_token_else,
+  scft_token_while,
+  scft_token_return,
+
+  scft_token_left_paren,
+  scft_token_right_paren,
+  scft_token_left_brace,
+  scft_token_right_brace,
+  scft_token_left_bracket,
+  scft_token_right_bracket,
+  scft_token_semicolon,
+  scft_token_colon,
+  scft_token_comma,
+  scft_token_dot,
+  scft_token_arrow,
+  scft_token_assign,
+  scft_token_equal,
+  scft_token_not,
+  scft_token_not_equal,
+  scft_token_less,
+  scft_token_less_equal,
+  scft_token_greater,
+  scft_token_greater_equal,
+  scft_token_plus,
+  scft_token_minus,
+  scft_token_star,
+  scft_token_slash,
+};
+
+extern ucl::LexerSpec scft_lexer_spec;
+
+#endif